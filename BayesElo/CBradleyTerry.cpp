@@ -10,6 +10,7 @@
 #include "./CBradleyTerry.h"
 
 #include <cmath>
+#include <cstdint>
 
 #include <iostream>  // NOLINT(readability/streams)
 #include <vector>
@@ -19,41 +20,164 @@
 #include "./CCDistribution.h"
 #include "./CMatrix.h"
 #include "./CLUDecomposition.h"
+#include "./CSparseCholesky.h"
 #include "./random.h"
+#include "./CThreadPool.h"
 
 #include "./CMatrixIO.h"
 
 /////////////////////////////////////////////////////////////////////////////
-// One iteration of the MM algorithm on gammas
+// Smallest number of opponent entries worth giving to a thread
+/////////////////////////////////////////////////////////////////////////////
+static const int MinEntriesPerBlock = 2048;
+
 /////////////////////////////////////////////////////////////////////////////
-void CBradleyTerry::UpdateGammas() {
+// Flatten opponent lists and split players into blocks of similar work
+/////////////////////////////////////////////////////////////////////////////
+void CBradleyTerry::BuildMMData() {
+  const int Players = crs.GetPlayers();
+
+  vRowBegin.resize(Players + 1);
+  vRowBegin[0] = 0;
+  for (int Player = 0; Player < Players; Player++)
+    vRowBegin[Player + 1] = vRowBegin[Player] + crs.GetOpponents(Player);
+  const int Entries = vRowBegin[Players];
+
+  int Blocks = Entries / MinEntriesPerBlock;
+  if (Blocks > Threads)
+    Blocks = Threads;
+  if (Blocks > Players)
+    Blocks = Players;
+  if (Blocks < 1)
+    Blocks = 1;
+
+  vBlockBegin.resize(Blocks + 1);
+  vBlockBegin[0] = 0;
+  for (int b = 1, Player = 0; b < Blocks; b++) {
+    int64_t Target = int64_t(Entries) * b / Blocks;
+    while (Player < Players && vRowBegin[Player] < Target)
+      Player++;
+    vBlockBegin[b] = Player;
+  }
+  vBlockBegin[Blocks] = Players;
+
+  vRowSplit.resize(Players);
+  vOpponent.resize(Entries);
+  vWinDraw_ij.resize(Entries);
+  vLossDraw_ij.resize(Entries);
+  vWinDraw_ji.resize(Entries);
+  vLossDraw_ji.resize(Entries);
+  vNumerator.resize(Players);
+  ThetaWNumerator = 0;
+  ThetaDNumerator = 0;
+
   //
-  // Loop over players
+  // Opponents of the same block come first, so that the update of a
+  // block only reads gammas of other blocks from the previous iteration
   //
-  for (int Player = crs.GetPlayers(); --Player >= 0;) {
-    double A = 0;
-    double B = 0;
-    for (int j = crs.GetOpponents(Player); --j >= 0;) {
-      const CCondensedResult &cr = crs.GetCondensedResult(Player, j);
-
-      double OpponentGamma;
-      if (cr.Opponent > Player)
-        OpponentGamma = pNextGamma[cr.Opponent];
-      else
-        OpponentGamma = pGamma[cr.Opponent];
-
-      A += cr.w_ij + cr.d_ij + cr.l_ji + cr.d_ji;
-      B += (cr.d_ij + cr.w_ij) * ThetaW /
-          (ThetaW * pGamma[Player] + ThetaD * OpponentGamma) +
-          (cr.d_ij + cr.l_ij) * ThetaD * ThetaW /
-          (ThetaD * ThetaW * pGamma[Player] + OpponentGamma) +
-          (cr.d_ji + cr.w_ji) * ThetaD /
-          (ThetaW * OpponentGamma + ThetaD * pGamma[Player]) +
-          (cr.d_ji + cr.l_ji) /
-          (ThetaD * ThetaW * OpponentGamma + pGamma[Player]);
+  for (int b = 0; b < Blocks; b++)
+    for (int Player = vBlockBegin[b]; Player < vBlockBegin[b + 1]; Player++) {
+      int k = vRowBegin[Player];
+      double A = 0;
+      for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1)
+          vRowSplit[Player] = k;
+        for (int j = crs.GetOpponents(Player); --j >= 0;) {
+          const CCondensedResult &cr = crs.GetCondensedResult(Player, j);
+          bool fInBlock = cr.Opponent >= vBlockBegin[b] &&
+              cr.Opponent < vBlockBegin[b + 1];
+          if (fInBlock != (pass == 0))
+            continue;
+          vOpponent[k] = cr.Opponent;
+          vWinDraw_ij[k] = cr.d_ij + cr.w_ij;
+          vLossDraw_ij[k] = cr.d_ij + cr.l_ij;
+          vWinDraw_ji[k] = cr.d_ji + cr.w_ji;
+          vLossDraw_ji[k] = cr.d_ji + cr.l_ji;
+          A += cr.w_ij + cr.d_ij + cr.l_ji + cr.d_ji;
+          ThetaWNumerator += cr.w_ij + cr.d_ij;
+          ThetaDNumerator += cr.d_ij;
+          k++;
+        }
+      }
+      vNumerator[Player] = A;
     }
-    pNextGamma[Player] = A / B;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Denominator of the MM update of one player, over a range of opponents
+/////////////////////////////////////////////////////////////////////////////
+static double GammaDenominator(int Begin,
+                               int End,
+                               const int *pOpponent,
+                               const double *pWinDraw_ij,
+                               const double *pLossDraw_ij,
+                               const double *pWinDraw_ji,
+                               const double *pLossDraw_ji,
+                               const double *pOpponentGamma,
+                               double PlayerGamma,
+                               double ThetaW,
+                               double ThetaD) {
+  const double ThetaDW = ThetaD * ThetaW;
+  double B = 0;
+#pragma omp simd reduction(+:B)
+  for (int k = Begin; k < End; k++) {
+    double OpponentGamma = pOpponentGamma[pOpponent[k]];
+    B += pWinDraw_ij[k] * ThetaW /
+        (ThetaW * PlayerGamma + ThetaD * OpponentGamma) +
+        pLossDraw_ij[k] * ThetaDW /
+        (ThetaDW * PlayerGamma + OpponentGamma) +
+        pWinDraw_ji[k] * ThetaD /
+        (ThetaW * OpponentGamma + ThetaD * PlayerGamma) +
+        pLossDraw_ji[k] /
+        (ThetaDW * OpponentGamma + PlayerGamma);
   }
+  return B;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// One MM iteration on the gammas of a block of players
+// Gauss-Seidel inside the block, Jacobi between blocks
+/////////////////////////////////////////////////////////////////////////////
+void CBradleyTerry::UpdateGammaBlock(int Block) {
+  const int Begin = vBlockBegin[Block];
+  const int End = vBlockBegin[Block + 1];
+
+  for (int Player = Begin; Player < End; Player++)
+    pNextGamma[Player] = pGamma[Player];
+
+  for (int Player = End; --Player >= Begin;) {
+    double B = GammaDenominator(vRowBegin[Player],
+                                vRowSplit[Player],
+                                &vOpponent[0],
+                                &vWinDraw_ij[0],
+                                &vLossDraw_ij[0],
+                                &vWinDraw_ji[0],
+                                &vLossDraw_ji[0],
+                                pNextGamma,
+                                pGamma[Player],
+                                ThetaW,
+                                ThetaD) +
+               GammaDenominator(vRowSplit[Player],
+                                vRowBegin[Player + 1],
+                                &vOpponent[0],
+                                &vWinDraw_ij[0],
+                                &vLossDraw_ij[0],
+                                &vWinDraw_ji[0],
+                                &vLossDraw_ji[0],
+                                pGamma,
+                                pGamma[Player],
+                                ThetaW,
+                                ThetaD);
+    pNextGamma[Player] = vNumerator[Player] / B;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// One iteration of the MM algorithm on gammas
+/////////////////////////////////////////////////////////////////////////////
+void CBradleyTerry::UpdateGammas(CThreadPool &tp) {
+  tp.Run(static_cast<int>(vBlockBegin.size()) - 1,
+         [this](int Block) {UpdateGammaBlock(Block);});
 
   //
   // Swap buffers to prepare next iteration
@@ -68,45 +192,61 @@ void CBradleyTerry::UpdateGammas() {
 /////////////////////////////////////////////////////////////////////////////
 // MM on ThetaW
 /////////////////////////////////////////////////////////////////////////////
-double CBradleyTerry::UpdateThetaW() {
-  double Numerator = 0;
-  double Denominator = 0;
+double CBradleyTerry::UpdateThetaW(CThreadPool &tp) {
+  const int Blocks = static_cast<int>(vBlockBegin.size()) - 1;
+  std::vector<double> vDenominator(Blocks);
 
-  for (int Player = crs.GetPlayers(); --Player >= 0;)
-    for (int j = crs.GetOpponents(Player); --j >= 0;) {
-      const CCondensedResult &cr = crs.GetCondensedResult(Player, j);
-      double OpponentGamma = pGamma[cr.Opponent];
-
-      Numerator += cr.w_ij + cr.d_ij;
-      Denominator += (cr.d_ij + cr.w_ij) * pGamma[Player] /
-          (ThetaW * pGamma[Player] + ThetaD * OpponentGamma) +
-          (cr.d_ij + cr.l_ij) * ThetaD * pGamma[Player] /
-          (ThetaD * ThetaW * pGamma[Player] + OpponentGamma);
+  tp.Run(Blocks, [&](int Block) {
+    double Denominator = 0;
+    for (int Player = vBlockBegin[Block + 1]; --Player >= vBlockBegin[Block];) {
+      double PlayerGamma = pGamma[Player];
+#pragma omp simd reduction(+:Denominator)
+      for (int k = vRowBegin[Player]; k < vRowBegin[Player + 1]; k++) {
+        double OpponentGamma = pGamma[vOpponent[k]];
+        Denominator += vWinDraw_ij[k] * PlayerGamma /
+            (ThetaW * PlayerGamma + ThetaD * OpponentGamma) +
+            vLossDraw_ij[k] * ThetaD * PlayerGamma /
+            (ThetaD * ThetaW * PlayerGamma + OpponentGamma);
+      }
     }
+    vDenominator[Block] = Denominator;
+  });
 
-  return Numerator / Denominator;
+  double Denominator = 0;
+  for (int Block = 0; Block < Blocks; Block++)
+    Denominator += vDenominator[Block];
+
+  return ThetaWNumerator / Denominator;
 }
 
 /////////////////////////////////////////////////////////////////////////////
 // MM on ThetaD
 /////////////////////////////////////////////////////////////////////////////
-double CBradleyTerry::UpdateThetaD() {
-  double Numerator = 0;
-  double Denominator = 0;
+double CBradleyTerry::UpdateThetaD(CThreadPool &tp) {
+  const int Blocks = static_cast<int>(vBlockBegin.size()) - 1;
+  std::vector<double> vDenominator(Blocks);
 
-  for (int Player = crs.GetPlayers(); --Player >= 0;)
-    for (int j = crs.GetOpponents(Player); --j >= 0;) {
-      const CCondensedResult &cr = crs.GetCondensedResult(Player, j);
-      double OpponentGamma = pGamma[cr.Opponent];
-
-      Numerator += cr.d_ij;
-      Denominator += (cr.d_ij + cr.w_ij) * OpponentGamma /
-          (ThetaW * pGamma[Player] + ThetaD * OpponentGamma) +
-          (cr.d_ij + cr.l_ij) * ThetaW * pGamma[Player] /
-          (ThetaD * ThetaW * pGamma[Player] + OpponentGamma);
+  tp.Run(Blocks, [&](int Block) {
+    double Denominator = 0;
+    for (int Player = vBlockBegin[Block + 1]; --Player >= vBlockBegin[Block];) {
+      double PlayerGamma = pGamma[Player];
+#pragma omp simd reduction(+:Denominator)
+      for (int k = vRowBegin[Player]; k < vRowBegin[Player + 1]; k++) {
+        double OpponentGamma = pGamma[vOpponent[k]];
+        Denominator += vWinDraw_ij[k] * OpponentGamma /
+            (ThetaW * PlayerGamma + ThetaD * OpponentGamma) +
+            vLossDraw_ij[k] * ThetaW * PlayerGamma /
+            (ThetaD * ThetaW * PlayerGamma + OpponentGamma);
+      }
     }
+    vDenominator[Block] = Denominator;
+  });
+
+  double Denominator = 0;
+  for (int Block = 0; Block < Blocks; Block++)
+    Denominator += vDenominator[Block];
 
-  double C = Numerator / Denominator;
+  double C = ThetaDNumerator / Denominator;
 
   return C + std::sqrt(C * C + 1);
 }
@@ -137,7 +277,8 @@ CBradleyTerry::CBradleyTerry(const CCondensedResults &crsInit)
       v1(crs.GetPlayers()),
       v2(crs.GetPlayers()),
       pGamma(&v1[0]),
-      pNextGamma(&v2[0]) {
+      pNextGamma(&v2[0]),
+      Threads(CThreadPool::DefaultThreads()) {
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -152,27 +293,37 @@ void CBradleyTerry::ConvertEloToGamma() const {
 
 /////////////////////////////////////////////////////////////////////////////
 // MM Algorithm
+// With fWarmStart, iterations start from the current Elos, advantage and
+// draw Elo instead of from equal ratings.
 /////////////////////////////////////////////////////////////////////////////
 void CBradleyTerry::MinorizationMaximization(int fThetaW,
                                              int fThetaD,
-                                             double Epsilon) {
+                                             double Epsilon,
+                                             int fWarmStart) {
   //
   // Set initial values
   //
-  ThetaW = fThetaW ? 1.0 : std::pow(10.0, eloAdvantage/400.0);
-  ThetaD = fThetaD ? 1.0 : std::pow(10.0, eloDraw/400.0);
-  for (int i = crs.GetPlayers(); --i >= 0;)
-    pGamma[i] = 1.0;
+  if (fWarmStart) {
+    ConvertEloToGamma();
+  } else {
+    ThetaW = fThetaW ? 1.0 : std::pow(10.0, eloAdvantage/400.0);
+    ThetaD = fThetaD ? 1.0 : std::pow(10.0, eloDraw/400.0);
+    for (int i = crs.GetPlayers(); --i >= 0;)
+      pGamma[i] = 1.0;
+  }
+
+  BuildMMData();
+  CThreadPool tp(static_cast<int>(vBlockBegin.size()) - 1);
 
   //
   // Main MM loop
   //
   for (int i = 0; i < 10000; i++) {
-    UpdateGammas();
+    UpdateGammas(tp);
     double Diff = GetDifference(crs.GetPlayers(), pGamma, pNextGamma);
 
     if (fThetaW) {
-      double NewThetaW = UpdateThetaW();
+      double NewThetaW = UpdateThetaW(tp);
       double ThetaW_Diff = std::fabs(ThetaW - NewThetaW);
       if (ThetaW_Diff > Diff)
         Diff = ThetaW_Diff;
@@ -180,7 +331,7 @@ void CBradleyTerry::MinorizationMaximization(int fThetaW,
     }
 
     if (fThetaD) {
-      double NewThetaD = UpdateThetaD();
+      double NewThetaD = UpdateThetaD(tp);
       double ThetaD_Diff = std::fabs(ThetaD - NewThetaD);
       if (ThetaD_Diff > Diff)
         Diff = ThetaD_Diff;
@@ -380,10 +531,24 @@ void CBradleyTerry::GetVariance(double *pdVariance) const {
 // This function assumes that ratings are maximum-likelihood ratings
 /////////////////////////////////////////////////////////////////////////////
 void CBradleyTerry::ComputeCovariance() {
+  const int n = crs.GetPlayers();
+
+  //
+  // Sparsity pattern of the truncated Hessian (the opponent graph)
+  //
+  std::vector<std::vector<int> > vvNeighbour(n - 1);
+  for (int Player = n - 1; --Player >= 0;)
+    for (int j = crs.GetOpponents(Player); --j >= 0;) {
+      int Opponent = crs.GetCondensedResult(Player, j).Opponent;
+      if (Opponent != n - 1)
+        vvNeighbour[Player].push_back(Opponent);
+    }
+  CSparseCholesky spc(vvNeighbour);
+
   //
   // Compute the truncated opposite of the Hessian
   //
-  CMatrix mTruncatedHessian(crs.GetPlayers() - 1, crs.GetPlayers() - 1);
+  CMatrix mTruncatedHessian(n - 1, n - 1);
   {
     ConvertEloToGamma();
 
@@ -392,7 +557,7 @@ void CBradleyTerry::ComputeCovariance() {
 
     mTruncatedHessian.Zero();
 
-    for (int Player = crs.GetPlayers() - 1; --Player >= 0;) {
+    for (int Player = n - 1; --Player >= 0;) {
       double Diag = 0;
       double PlayerGamma = pGamma[Player];
 
@@ -421,14 +586,68 @@ void CBradleyTerry::ComputeCovariance() {
 
         h *= PlayerGamma * OpponentGamma * ThetaD * ThetaW;
         Diag -= h;
-        if (cr.Opponent != crs.GetPlayers() - 1)
+        if (cr.Opponent != n - 1) {
           mTruncatedHessian.SetElement(Player, cr.Opponent, h * xx);
+          spc.SetElement(Player, cr.Opponent, h * xx);
+        }
       }
 
       mTruncatedHessian.SetElement(Player, Player, Diag * xx);
+      spc.SetElement(Player, Player, Diag * xx);
     }
   }
 
+  //
+  // Fall back to dense LU if the matrix is not positive definite
+  // (players without games)
+  //
+  if (!spc.Decompose()) {
+    ComputeCovarianceLU(mTruncatedHessian);
+    return;
+  }
+
+  //
+  // Inverse of the truncated Hessian, one column per task
+  //
+  CMatrix mInverse(n - 1, n - 1);
+  {
+    CThreadPool tp(Threads);
+    tp.Run(n - 1, [&](int j) {
+      spc.SolveUnit(j, mInverse + j * (n - 1));
+    });
+  }
+
+  //
+  // The covariance is A C A^T with A = P - u v^T / n, where P is the
+  // identity with an extra null row, u and v are vectors of ones, and C
+  // is the inverse. Expanding the product only needs row sums of C.
+  //
+  std::vector<double> vRowSum(n, 0.0);
+  double Total = 0;
+  for (int i = n - 1; --i >= 0;) {
+    const double *pRow = mInverse + i * (n - 1);
+    double Sum = 0;
+    for (int j = 0; j < n - 1; j++)
+      Sum += pRow[j];
+    vRowSum[i] = Sum;
+    Total += Sum;
+  }
+
+  mCovariance.SetSize(n, n);
+  const double Corner = Total / (double(n) * n);
+  for (int i = n; --i >= 0;)
+    for (int j = n; --j >= 0;) {
+      double c = Corner - (vRowSum[i] + vRowSum[j]) / n;
+      if (i < n - 1 && j < n - 1)
+        c += mInverse.GetElement(i, j);
+      mCovariance.SetElement(i, j, c);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Covariance from a dense LU decomposition of the truncated Hessian
+/////////////////////////////////////////////////////////////////////////////
+void CBradleyTerry::ComputeCovarianceLU(CMatrix &mTruncatedHessian) {
   //
   // LU-Decompose it
   //
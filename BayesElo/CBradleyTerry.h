@@ -14,6 +14,7 @@ class CResultSet;
 class CCondensedResults;
 class CCDistribution;
 class CDistributionCollection;
+class CThreadPool;
 
 #include <cmath>
 #include <vector>
@@ -35,6 +36,24 @@ private:  ///////////////////////////////////////////////////////////////////
   mutable double ThetaW;
   mutable double ThetaD;
 
+  //
+  // Opponent lists flattened for the MM loop, split into player blocks
+  // that are updated in parallel. Rebuilt on each run, since priors may
+  // have changed the condensed results in between.
+  //
+  int Threads;
+  std::vector<int> vBlockBegin;
+  std::vector<int> vRowBegin;
+  std::vector<int> vRowSplit;
+  std::vector<int> vOpponent;
+  std::vector<double> vWinDraw_ij;
+  std::vector<double> vLossDraw_ij;
+  std::vector<double> vWinDraw_ji;
+  std::vector<double> vLossDraw_ji;
+  std::vector<double> vNumerator;
+  double ThetaWNumerator;
+  double ThetaDNumerator;
+
   CMatrix mCovariance;
   CMatrix mLOS;
   CMatrix mWinProbability;
@@ -42,10 +61,13 @@ private:  ///////////////////////////////////////////////////////////////////
   CMatrix mDrawProbability;
 
   void ConvertEloToGamma() const;
-  void UpdateGammas();
-  double UpdateThetaW();
-  double UpdateThetaD();
+  void BuildMMData();
+  void UpdateGammaBlock(int Block);
+  void UpdateGammas(CThreadPool &tp);
+  double UpdateThetaW(CThreadPool &tp);
+  double UpdateThetaD(CThreadPool &tp);
   double GetDifference(int n, const double *pd1, const double *pd2);
+  void ComputeCovarianceLU(CMatrix &mTruncatedHessian);
 
 public:  ////////////////////////////////////////////////////////////////////
   CBradleyTerry(const CCondensedResults &crsInit);
@@ -57,6 +79,7 @@ public:  ////////////////////////////////////////////////////////////////////
   double GetElo(int i) const {return velo[i];}
   double GetAdvantage() const {return eloAdvantage;}
   double GetDrawElo() const {return eloDraw;}
+  int GetThreads() const {return Threads;}
 
   //
   // Sets
@@ -65,13 +88,15 @@ public:  ////////////////////////////////////////////////////////////////////
   void SetElo(int i, double x) {velo[i] = x;}
   void SetAdvantage(double x) {eloAdvantage = x;}
   void SetDrawElo(double x) {eloDraw = x;}
+  void SetThreads(int n) {Threads = n > 0 ? n : 1;}
 
   //
   // Methods to compute elo ratings
   //
   void MinorizationMaximization(int fThetaW,
                                 int fThetaD,
-                                double Epsilon = 1e-5);
+                                double Epsilon = 1e-5,
+                                int fWarmStart = 0);
   void ELOstat(double Epsilon = 1e-5);
   void ELOstatIntervals(double *peloLower, double *peloUpper) const;
 
@@ -9,10 +9,13 @@
 /////////////////////////////////////////////////////////////////////////////
 #include "./CCondensedResults.h"
 
+#include <algorithm>
 #include <set>
 #include <iostream>  // NOLINT(readability/streams)
+#include <vector>
 
 #include "./CResultSet.h"
+#include "./CResultStore.h"
 #include "./debug.h"
 
 /////////////////////////////////////////////////////////////////////////////
@@ -77,6 +80,63 @@ CCondensedResults::CCondensedResults(const CResultSet &rs)
   }
 }
 
+/////////////////////////////////////////////////////////////////////////////
+// Constructor from stored pairwise counts
+// Takes time proportional to the number of pairs, not games
+/////////////////////////////////////////////////////////////////////////////
+CCondensedResults::CCondensedResults(const CResultStore &rst)
+    : Players(rst.GetPlayers()) {
+  pOpponents = new int[Players];
+  ppcr = new CCondensedResult*[Players];
+
+  //
+  // Sort both directions of each pair by player, then opponent
+  //
+  std::vector<std::pair<int, int> > vEdge;
+  vEdge.reserve(2 * rst.GetPairs());
+  for (int i = rst.GetPairs(); --i >= 0;) {
+    const CPairResults &pr = rst.GetPair(i);
+    if (pr.Games() == 0)
+      continue;
+    vEdge.push_back(std::make_pair(pr.White, pr.Black));
+    vEdge.push_back(std::make_pair(pr.Black, pr.White));
+  }
+  std::sort(vEdge.begin(), vEdge.end());
+  vEdge.erase(std::unique(vEdge.begin(), vEdge.end()), vEdge.end());
+
+  for (int i = Players; --i >= 0;)
+    pOpponents[i] = 0;
+  for (unsigned i = 0; i < vEdge.size(); i++)
+    pOpponents[vEdge[i].first]++;
+
+  for (int i = Players; --i >= 0;) {
+    ppcr[i] = new CCondensedResult[pOpponents[i]];
+    for (int j = pOpponents[i]; --j >= 0;)
+      ppcr[i][j].Reset();
+  }
+
+  //
+  // Fill-in all CCondensedResult's
+  //
+  for (int i = rst.GetPairs(); --i >= 0;) {
+    const CPairResults &pr = rst.GetPair(i);
+    if (pr.Games() == 0)
+      continue;
+
+    CCondensedResult &crWhite = FindOpponent(pr.White, pr.Black);
+    CCondensedResult &crBlack = FindOpponent(pr.Black, pr.White);
+    crWhite.TrueGames += pr.Games();
+    crBlack.TrueGames += pr.Games();
+
+    crWhite.w_ij += pr.w;
+    crWhite.d_ij += pr.d;
+    crWhite.l_ij += pr.l;
+    crBlack.w_ji += pr.w;
+    crBlack.d_ji += pr.d;
+    crBlack.l_ji += pr.l;
+  }
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Add prior
 /////////////////////////////////////////////////////////////////////////////
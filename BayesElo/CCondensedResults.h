@@ -13,6 +13,7 @@
 #include <iosfwd>
 
 class CResultSet;
+class CResultStore;
 
 class CCondensedResult {  // cr
  public:
@@ -38,6 +39,7 @@ private:  ///////////////////////////////////////////////////////////////////
 
 public:  ////////////////////////////////////////////////////////////////////
   CCondensedResults(const CResultSet &rs);
+  CCondensedResults(const CResultStore &rst);
 
   void AddPrior(float PriorDraw);
 
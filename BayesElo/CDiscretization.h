@@ -24,6 +24,8 @@ CDiscretization(int SizeInit, double MinInit, double MaxInit)
       }
 
   int GetDiscretizationSize() const {return Size;}
+  double GetMin() const {return Min;}
+  double GetMax() const {return Max;}
 
   int IndexFromValue(double x) const {
     return static_cast<int>(0.5 + (Size - 1) * (x - Min) / (Max - Min));
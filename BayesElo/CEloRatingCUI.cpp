@@ -63,6 +63,7 @@ const char * const CEloRatingCUI::tszCommands[] = {
   "advdist",
   "drawdist",
   "pairstats",
+  "threads",
   0
 };
 
@@ -76,6 +77,84 @@ static int RoundDouble(double x) {
     return static_cast<int>(x-0.5);
 }
 
+////////////////////////////////////////////////////////////////////////////
+// Table of the ratings command
+////////////////////////////////////////////////////////////////////////////
+void CEloRatingCUI::PrintRatings(std::ostream &out,
+                                 const CCondensedResults &crs,
+                                 const CCondensedResults &crsNoPrior,
+                                 const std::vector<std::string> &vecName,
+                                 const double *pElo,
+                                 double EloScale,
+                                 double eloOffset,
+                                 const double *pUpper,
+                                 const double *pLower,
+                                 int MinGames,
+                                 const std::set<std::string> *psetNames,
+                                 int fFullRank) {
+  std::vector<int> vPermutation(crs.GetPlayers());
+  for (int i = crs.GetPlayers(); --i >= 0;)
+    vPermutation[i] = i;
+  std::sort(vPermutation.begin(),
+            vPermutation.end(),
+            CIndirectCompare<double>(pElo));
+
+  int Width = 4;
+  for (int i = crs.GetPlayers(); --i >= 0;)
+    if (static_cast<int>(vecName[i].length()) > Width)
+      Width = vecName[i].length();
+
+  std::ios::fmtflags f = out.flags();
+  out.setf(std::ios::right, std::ios::adjustfield);
+  out << std::setw(3) << "Rank" << ' ';
+  out.setf(std::ios::left, std::ios::adjustfield);
+  out << std::setw(Width) << "Name" << ' ';
+  out.setf(std::ios::right, std::ios::adjustfield);
+  out << std::setw(5) << "Elo" << ' ';
+  if (pUpper && pLower) {
+    out << std::setw(4) << "  +" << ' ';
+    out << std::setw(4) << "  -" << ' ';
+  }
+  out << std::setw(5) << "games" << ' ';
+  out << std::setw(5) << "score" << ' ';
+  out << std::setw(5) << "oppo." << ' ';
+  out << std::setw(5) << "draws" << ' ';
+  out << '\n';
+
+  for (int i = 0, Counter = 0; i < crs.GetPlayers(); i++) {
+    int j = vPermutation[i];
+    float Games = crsNoPrior.CountGames(j);
+    if (Games >= MinGames &&
+        (psetNames == 0 || psetNames->size() == 0 ||
+         psetNames->find(vecName[j]) != psetNames->end())) {
+      Counter++;
+      double Score = static_cast<double>(crsNoPrior.Score(j)) / 2;
+      out.setf(std::ios::right, std::ios::adjustfield);
+      if (fFullRank)
+        out << std::setw(4) << i + 1 << ' ';
+      else
+        out << std::setw(4) << Counter << ' ';
+      out.setf(std::ios::left, std::ios::adjustfield);
+      out << std::setw(Width) << vecName[j] << ' ';
+      out.setf(std::ios::right, std::ios::adjustfield);
+      out << std::setw(5) << RoundDouble(EloScale * pElo[j] + eloOffset) << ' ';
+      if (pUpper && pLower) {
+        out << std::setw(4) << RoundDouble(EloScale * pUpper[j]) << ' ';
+        out << std::setw(4) << RoundDouble(EloScale * pLower[j]) << ' ';
+      }
+      out << std::setw(5) << Games << ' ';
+      out << std::setw(4) << RoundDouble(100 * Score / Games) << "% ";
+      out << std::setw(5) <<
+          RoundDouble(EloScale * crs.AverageOpponent(j, pElo) + eloOffset) << ' ';
+      out << std::setw(4) << RoundDouble(100 * crsNoPrior.CountDraws(j) /
+                                         static_cast<double>(Games)) << "% ";
+      out << '\n';
+    }
+  }
+
+  out.flags(f);
+}
+
 ////////////////////////////////////////////////////////////////////////////
 // Constructor
 ////////////////////////////////////////////////////////////////////////////
@@ -179,7 +258,8 @@ int CEloRatingCUI::ProcessCommand(const char *pszCommand,
     IDC_LOS,
     IDC_AdvDist,
     IDC_DrawDist,
-    IDC_PairStats
+    IDC_PairStats,
+    IDC_Threads
   };
 
   switch (ArrayLookup(pszCommand, tszCommands)) {
@@ -194,6 +274,7 @@ int CEloRatingCUI::ProcessCommand(const char *pszCommand,
       out << "mm [a] [d] ...... compute maximum-likelihood Elos:\n";
       out << "                   a: flag to compute advantage (default = 0)\n";
       out << "                   d: flag to compute elodraw (default = 0)\n";
+      out << "threads [n] ..... get[set] number of threads used by mm\n";
       out << "elostat ......... compute ratings with ELOstat algorithm\n";
       out << '\n';
       out << "ratings [min [f [F]]] list players and their ratings:\n";
@@ -223,7 +304,9 @@ int CEloRatingCUI::ProcessCommand(const char *pszCommand,
       out << "minelo [x] ...... get[set] minimum Elo\n";
       out << "maxelo [x] ...... get[set] maximum Elo\n";
       out << "resolution [n] .. get[set] resolution\n";
-      out << "jointdist [p] ... compute intervals from joint distribution\n";
+      out << "jointdist [p] [m] compute intervals from joint distribution\n";
+      out << "                   m: log-likelihood pruning margin, approximate\n";
+      out << "                      (default = 0, exact)\n";
       out << "exactdist [p] ... compute intervals assuming exact opponent Elos\n";
       out << "advdist ......... likelihood distribution of advantage\n";
       out << "drawdist ........ likelihood distribution of drawelo\n";
@@ -558,61 +641,10 @@ int CEloRatingCUI::ProcessCommand(const char *pszCommand,
             break;
         }
 
-        std::sort(vPermutation.begin(),
-                  vPermutation.end(),
-                  CIndirectCompare<double>(bt.GetElo()));
-
-        int Width = MaxNameLength;
-        if (Width < 4)
-          Width = 4;
-
         CCondensedResults crsNoPrior(rs);
-
-        std::ios::fmtflags f = out.flags();
-        out.setf(std::ios::right, std::ios::adjustfield);
-        out << std::setw(3) << "Rank" << ' ';
-        out.setf(std::ios::left, std::ios::adjustfield);
-        out << std::setw(Width) << "Name" << ' ';
-        out.setf(std::ios::right, std::ios::adjustfield);
-        out << std::setw(5) << "Elo" << ' ';
-        out << std::setw(4) << "  +" << ' ';
-        out << std::setw(4) << "  -" << ' ';
-        out << std::setw(5) << "games" << ' ';
-        out << std::setw(5) << "score" << ' ';
-        out << std::setw(5) << "oppo." << ' ';
-        out << std::setw(5) << "draws" << ' ';
-        out << '\n';
-
-        const double *pElo = bt.GetElo();
-        for (int i = 0, Counter = 0; i < crs.GetPlayers(); i++) {
-          int j = vPermutation[i];
-          float Games = crsNoPrior.CountGames(j);
-          if (Games >= MinGames &&
-              (setNames.size() == 0 || setNames.find(vecName[j]) != setNames.end())) {
-            Counter++;
-            double Score = static_cast<double>(crsNoPrior.Score(j)) / 2;
-            out.setf(std::ios::right, std::ios::adjustfield);
-            if (fFullRank)
-              out << std::setw(4) << i + 1 << ' ';
-            else
-              out << std::setw(4) << Counter << ' ';
-            out.setf(std::ios::left, std::ios::adjustfield);
-            out << std::setw(Width) << vecName[j] << ' ';
-            out.setf(std::ios::right, std::ios::adjustfield);
-            out << std::setw(5) << RoundDouble(EloScale * bt.GetElo(j) + eloOffset) << ' ';
-            out << std::setw(4) << RoundDouble(EloScale * veloUpper[j]) << ' ';
-            out << std::setw(4) << RoundDouble(EloScale * veloLower[j]) << ' ';
-            out << std::setw(5) << Games << ' ';
-            out << std::setw(4) << RoundDouble(100 * Score / Games) << "% ";
-            out << std::setw(5) <<
-                RoundDouble(EloScale * crs.AverageOpponent(j, pElo) + eloOffset) << ' ';
-            out << std::setw(4) << RoundDouble(100 * crsNoPrior.CountDraws(j) /
-                                               static_cast<double>(Games)) << "% ";
-            out << '\n';
-          }
-        }
-
-        out.flags(f);
+        PrintRatings(out, crs, crsNoPrior, vecName, bt.GetElo(), EloScale,
+                     eloOffset, &veloUpper[0], &veloLower[0], MinGames,
+                     &setNames, fFullRank);
       }
       break;
 
@@ -738,6 +770,13 @@ int CEloRatingCUI::ProcessCommand(const char *pszCommand,
       }
       break;
 
+    case IDC_Threads: {  ////////////////////////////////////////////////////////
+        int Threads = bt.GetThreads();
+        GetSet<int>(Threads, pszParameters, out);
+        bt.SetThreads(Threads);
+      }
+      break;
+
     case IDC_ELOstat: {  ////////////////////////////////////////////////////////
         crs.AddPrior(-Prior);
         CClockTimer timer;
@@ -769,14 +808,18 @@ int CEloRatingCUI::ProcessCommand(const char *pszCommand,
 
     case IDC_JointDist: {  //////////////////////////////////////////////////////
         int Player = -1;
-        std::istringstream(pszParameters) >> Player;
+        double Margin = 0;
+        std::istringstream(pszParameters) >> Player >> Margin;
 
         CClockTimer timer;
         CDistributionCollection dc(crs.GetPlayers(),
                                    Resolution,
                                    eloMin,
                                    eloMax);
+        if (Margin > 0 && crs.GetPlayers() > 1)
+          bt.ComputeCovariance();
         CJointBayesian jb(rs, dc, bt);
+        jb.SetPruningMargin(Margin);
         jb.RunComputation();
         out << timer.GetInterval() << '\n';
         for (int i = crs.GetPlayers(); --i >= 0;) {
@@ -12,6 +12,8 @@
 #ifndef CEloRatingCUI_Declared
 #define CEloRatingCUI_Declared
 
+#include <iosfwd>
+#include <set>
 #include <vector>
 #include <string>
 
@@ -59,6 +61,24 @@ protected:  ////////////////////////////////////////////////////////////////
   virtual void PrintLocalPrompt(std::ostream &out);
 
 public:  ///////////////////////////////////////////////////////////////////
+  //
+  // Table of the ratings command: pElo, pUpper and pLower are unscaled,
+  // crsNoPrior counts the games.  Without pUpper and pLower, the + and -
+  // columns are left out.  An empty or null psetNames lists all players.
+  //
+  static void PrintRatings(std::ostream &out,
+                           const CCondensedResults &crs,
+                           const CCondensedResults &crsNoPrior,
+                           const std::vector<std::string> &vecName,
+                           const double *pElo,
+                           double EloScale,
+                           double eloOffset,
+                           const double *pUpper,
+                           const double *pLower,
+                           int MinGames = 1,
+                           const std::set<std::string> *psetNames = 0,
+                           int fFullRank = 0);
+
   CEloRatingCUI(const CResultSet &rsInit,
                 const std::vector<std::string> &vecNameInit,
                 CConsoleUI *pcui = 0,
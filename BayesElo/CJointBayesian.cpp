@@ -9,12 +9,21 @@
 /////////////////////////////////////////////////////////////////////////////
 #include "./CJointBayesian.h"
 
+#include <cmath>
 #include <iostream>  // NOLINT(readability/streams)
+#include <vector>
 
 #include "./CResultSet.h"
 #include "./CCDistribution.h"
 #include "./CDistributionCollection.h"
 #include "./CBradleyTerry.h"
+#include "./CMatrix.h"
+#include "./CThreadPool.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// Maximum number of independent accumulators for the parallel top level
+/////////////////////////////////////////////////////////////////////////////
+static const int MaxJointTasks = 64;
 
 /////////////////////////////////////////////////////////////////////////////
 // Constructor
@@ -25,9 +34,10 @@ CJointBayesian::CJointBayesian(const CResultSet &rsInit,
     : rs(rsInit),
       dc(dcInit),
       bt(btInit),
-      indexMax(dc.GetDiscretizationSize() - 1) {
-  pindex = new int[rs.GetPlayers()];
-
+      indexMax(dc.GetDiscretizationSize() - 1),
+      LogReference(0),
+      PruningMargin(0),
+      Threads(bt.GetThreads()) {
   //
   // Pre-compute probability cache
   //
@@ -44,64 +54,294 @@ CJointBayesian::CJointBayesian(const CResultSet &rsInit,
 /////////////////////////////////////////////////////////////////////////////
 CJointBayesian::~CJointBayesian() {
   delete[] pProbabilityCache;
-  delete[] pindex;
 }
 
 /////////////////////////////////////////////////////////////////////////////
-// Get probability from indices
+// Group games by pair of players into log-likelihood tables
+// vvvPairLog[p][k][indexMax + index(p) - index(partner)]
 /////////////////////////////////////////////////////////////////////////////
-double CJointBayesian::GetProbability() const {
-  double P = 1;
+void CJointBayesian::BuildPairTables() {
+  const int Players = rs.GetPlayers();
+  const int Diffs = indexMax * 2 + 1;
+
+  std::vector<std::vector<int> > vvSlot(Players, std::vector<int>(Players, -1));
+  vvPartner.assign(Players, std::vector<int>());
+  vvvPairLog.assign(Players, std::vector<std::vector<double> >());
 
   for (int i = rs.GetGames(); --i >= 0;) {
-#if 0
-    P *= bt.ResultProbability(dc.ValueFromIndex(pindex[rs.GetWhite(i)]),
-                              dc.ValueFromIndex(pindex[rs.GetBlack(i)]),
-                              rs.GetResult(i));
-#else
-    P *= pProbabilityCache[indexMax +
-                           pindex[rs.GetWhite(i)] -
-                           pindex[rs.GetBlack(i)] +
-                           rs.GetResult(i) * (indexMax * 2 + 1)];
-#endif
+    int White = rs.GetWhite(i);
+    int Black = rs.GetBlack(i);
+    if (White == Black)
+      continue;
+    int Player = White < Black ? White : Black;
+    int Partner = White < Black ? Black : White;
+
+    int &Slot = vvSlot[Player][Partner];
+    if (Slot < 0) {
+      Slot = vvPartner[Player].size();
+      vvPartner[Player].push_back(Partner);
+      vvvPairLog[Player].push_back(std::vector<double>(Diffs, 0.0));
+    }
+
+    std::vector<double> &vLog = vvvPairLog[Player][Slot];
+    const double *pCache = pProbabilityCache + rs.GetResult(i) * Diffs;
+    for (int d = Diffs; --d >= 0;) {
+      int WhiteMinusBlack = Player == White ? d : Diffs - 1 - d;
+      vLog[d] += std::log(pCache[WhiteMinusBlack]);
+    }
+  }
+
+  vRemainingMax.assign(Players + 1, 0.0);
+  for (int Player = 0; Player < Players; Player++) {
+    double Max = 0;
+    for (int k = vvPartner[Player].size(); --k >= 0;) {
+      const std::vector<double> &vLog = vvvPairLog[Player][k];
+      double PairMax = vLog[0];
+      for (int d = Diffs; --d > 0;)
+        if (vLog[d] > PairMax)
+          PairMax = vLog[d];
+      Max += PairMax;
+    }
+    vRemainingMax[Player + 1] = vRemainingMax[Player] + Max;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Log-likelihood of a complete assignment of indices
+/////////////////////////////////////////////////////////////////////////////
+double CJointBayesian::LogLikelihood(const int *pindex) const {
+  double Result = 0;
+  for (int Player = rs.GetPlayers(); --Player >= 0;)
+    for (int k = vvPartner[Player].size(); --k >= 0;)
+      Result += vvvPairLog[Player][k]
+          [indexMax + pindex[Player] - pindex[vvPartner[Player][k]]];
+  return Result;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Log-likelihood of a grid point close to the maximum
+// Start from the current ratings, then hill-climb by moving index mass
+// between pairs of players. Any grid point is a lower bound of the
+// maximum, so pruning relative to it is safe, and leaf probabilities
+// are scaled by it to avoid underflow.
+/////////////////////////////////////////////////////////////////////////////
+void CJointBayesian::ComputeLogReference() {
+  const int Players = rs.GetPlayers();
+  const int indexTotal = dc.GetDiscretizationSize() * Players / 2;
+
+  LogReference = 0;
+  vBestIndex.clear();
+  if (indexTotal > indexMax * Players)
+    return;
+
+  std::vector<int> vIndex(Players);
+  int Total = 0;
+  for (int i = Players; --i >= 0;) {
+    int Index = dc.IndexFromValue(bt.GetElo(i));
+    if (Index < 0)
+      Index = 0;
+    if (Index > indexMax)
+      Index = indexMax;
+    vIndex[i] = Index;
+    Total += Index;
+  }
+
+  for (int i = 0; Total != indexTotal; i = (i + 1) % Players) {
+    if (Total < indexTotal && vIndex[i] < indexMax) {
+      vIndex[i]++;
+      Total++;
+    } else if (Total > indexTotal && vIndex[i] > 0) {
+      vIndex[i]--;
+      Total--;
+    }
+  }
+
+  LogReference = LogLikelihood(&vIndex[0]);
+  for (int Step = indexMax / 2; Step > 0; Step /= 2) {
+    int fImproved = 1;
+    while (fImproved) {
+      fImproved = 0;
+      for (int i = Players; --i >= 0;)
+        for (int j = Players; --j >= 0;)
+          if (i != j && vIndex[i] + Step <= indexMax && vIndex[j] >= Step) {
+            vIndex[i] += Step;
+            vIndex[j] -= Step;
+            double L = LogLikelihood(&vIndex[0]);
+            if (L > LogReference) {
+              LogReference = L;
+              fImproved = 1;
+            } else {
+              vIndex[i] -= Step;
+              vIndex[j] += Step;
+            }
+          }
+    }
   }
 
-  return P;
+  vBestIndex = vIndex;
+  if (!std::isfinite(LogReference))
+    LogReference = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Index windows of players
+// Without pruning, every index is explored. With pruning, each player is
+// limited to the region where a Gaussian approximation of its marginal,
+// around the best grid point, keeps a log-density within the margin.
+/////////////////////////////////////////////////////////////////////////////
+void CJointBayesian::ComputeWindows() {
+  const int Players = rs.GetPlayers();
+  const CMatrix &mCovariance = bt.GetCovariance();
+  const double Step = dc.ValueFromIndex(1) - dc.ValueFromIndex(0);
+  const int fWindows = PruningMargin > 0 &&
+                       int(vBestIndex.size()) == Players &&
+                       mCovariance.GetRows() == Players &&
+                       mCovariance.GetColumns() == Players;
+
+  vLow.assign(Players, 0);
+  vHigh.assign(Players, indexMax);
+  if (fWindows)
+    for (int i = Players; --i >= 0;) {
+      double Sigma = std::sqrt(mCovariance.GetElement(i, i)) / Step;
+      if (!std::isfinite(Sigma))
+        continue;
+      int HalfWidth = 1 + static_cast<int>(std::sqrt(2 * PruningMargin) * Sigma);
+      if (vBestIndex[i] - HalfWidth > 0)
+        vLow[i] = vBestIndex[i] - HalfWidth;
+      if (vBestIndex[i] + HalfWidth < indexMax)
+        vHigh[i] = vBestIndex[i] + HalfWidth;
+    }
+
+  vSumLow.assign(Players + 1, 0);
+  vSumHigh.assign(Players + 1, 0);
+  for (int i = 0; i < Players; i++) {
+    vSumLow[i + 1] = vSumLow[i] + vLow[i];
+    vSumHigh[i + 1] = vSumHigh[i] + vHigh[i];
+  }
 }
 
 /////////////////////////////////////////////////////////////////////////////
 // Recursive helper function
+// LogP is the log-likelihood of games between players already assigned.
 /////////////////////////////////////////////////////////////////////////////
-void CJointBayesian::RecursiveJointBayesian(int player, int indexTotal) {
+void CJointBayesian::RecursiveJointBayesian(int player,
+                                            int indexTotal,
+                                            double LogP,
+                                            int *pindex,
+                                            CDistributionCollection &dcLocal)
+    const {
   if (player < 0) {
-    double p = GetProbability();
+    double p = std::exp(LogP - LogReference);
     for (int i = rs.GetPlayers(); --i >= 0;)
-      dc.GetDistribution(i).Add(pindex[i], p);
+      dcLocal.GetDistribution(i).Add(pindex[i], p);
     return;
   }
 
-  int max = indexMax;
-  if (max > indexTotal)
-    max = indexTotal;
+  int max = vHigh[player];
+  if (max > indexTotal - vSumLow[player])
+    max = indexTotal - vSumLow[player];
 
-  int min = 0;
-  if (min < indexTotal - player * indexMax)
-    min = indexTotal - player * indexMax;
+  int min = vLow[player];
+  if (min < indexTotal - vSumHigh[player])
+    min = indexTotal - vSumHigh[player];
 
-  for (pindex[player] = max + 1; --pindex[player] >= min;)
-    RecursiveJointBayesian(player - 1, indexTotal - pindex[player]);
+  const std::vector<int> &vPartner = vvPartner[player];
+  const std::vector<std::vector<double> > &vvPairLog = vvvPairLog[player];
+  const double LogThreshold = LogReference - PruningMargin;
+
+  for (pindex[player] = max + 1; --pindex[player] >= min;) {
+    double LogPChild = LogP;
+    for (int k = vPartner.size(); --k >= 0;)
+      LogPChild += vvPairLog[k][indexMax + pindex[player] - pindex[vPartner[k]]];
+
+    //
+    // Skip if even the best outcome of the remaining pairs is too unlikely
+    //
+    if (PruningMargin > 0 &&
+        !(LogPChild + vRemainingMax[player] >= LogThreshold))
+      continue;
+
+    RecursiveJointBayesian(player - 1,
+                           indexTotal - pindex[player],
+                           LogPChild,
+                           pindex,
+                           dcLocal);
+  }
 }
 
 /////////////////////////////////////////////////////////////////////////////
 // Estimate rating distributions
 /////////////////////////////////////////////////////////////////////////////
 void CJointBayesian::RunComputation() {
-  for (int i = rs.GetPlayers(); --i >= 0;)
+  const int Players = rs.GetPlayers();
+
+  for (int i = Players; --i >= 0;)
     dc.GetDistribution(i).Reset();
+  if (Players == 0)
+    return;
 
-  RecursiveJointBayesian(rs.GetPlayers() - 1,
-                         dc.GetDiscretizationSize() * rs.GetPlayers() / 2);
+  BuildPairTables();
+  ComputeLogReference();
+  ComputeWindows();
+
+  //
+  // Values of the top player are dealt round-robin to a fixed number of
+  // tasks, each with its own accumulator, so that the result does not
+  // depend on the number of threads
+  //
+  const int indexTotal = dc.GetDiscretizationSize() * Players / 2;
+  const int player = Players - 1;
+  int max = vHigh[player];
+  if (max > indexTotal - vSumLow[player])
+    max = indexTotal - vSumLow[player];
+  int min = vLow[player];
+  if (min < indexTotal - vSumHigh[player])
+    min = indexTotal - vSumHigh[player];
+
+  int Tasks = max - min + 1;
+  if (Tasks > MaxJointTasks)
+    Tasks = MaxJointTasks;
+  if (Tasks < 1)
+    Tasks = 1;
+
+  std::vector<CDistributionCollection *> vpdc(Tasks);
+  for (int t = Tasks; --t >= 0;) {
+    vpdc[t] = new CDistributionCollection(Players,
+                                          dc.GetDiscretizationSize(),
+                                          dc.GetMin(),
+                                          dc.GetMax());
+    for (int i = Players; --i >= 0;)
+      vpdc[t]->GetDistribution(i).Reset();
+  }
+
+  {
+    CThreadPool tp(Threads < Tasks ? Threads : Tasks);
+    tp.Run(Tasks, [&](int t) {
+      std::vector<int> vindex(Players);
+      for (int Index = max - t; Index >= min; Index -= Tasks) {
+        vindex[player] = Index;
+        RecursiveJointBayesian(player - 1,
+                               indexTotal - Index,
+                               0.0,
+                               &vindex[0],
+                               *vpdc[t]);
+      }
+    });
+  }
+
+  //
+  // Reduce in task order
+  //
+  for (int t = 0; t < Tasks; t++) {
+    for (int i = Players; --i >= 0;) {
+      CCDistribution &dist = dc.GetDistribution(i);
+      const CCDistribution &distLocal = vpdc[t]->GetDistribution(i);
+      for (int j = dist.GetSize(); --j >= 0;)
+        dist.Add(j, distLocal.GetProbability(j));
+    }
+    delete vpdc[t];
+  }
 
-  for (int i = rs.GetPlayers(); --i >= 0;)
+  for (int i = Players; --i >= 0;)
     dc.GetDistribution(i).Normalize();
 }
@@ -10,6 +10,8 @@
 #ifndef CJointBayesian_Declared
 #define CJointBayesian_Declared
 
+#include <vector>
+
 class CResultSet;
 class CDistributionCollection;
 class CBradleyTerry;
@@ -19,18 +21,60 @@ private:  //////////////////////////////////////////////////////////////////
   const CResultSet &rs;
   CDistributionCollection &dc;
   const CBradleyTerry &bt;
-  int *pindex;
   int indexMax;
   double *pProbabilityCache;
 
-  void RecursiveJointBayesian(int player, int indexTotal);
-  double GetProbability() const;
+  //
+  // Log-likelihood of the games between player and each partner with a
+  // higher number, as a function of the index difference. Partners are
+  // assigned first by the recursion, so these terms are known as soon
+  // as the index of player is chosen.
+  //
+  std::vector<std::vector<int> > vvPartner;
+  std::vector<std::vector<std::vector<double> > > vvvPairLog;
+
+  //
+  // vRemainingMax[p]: upper bound of the log-likelihood of all games
+  // that are still unknown once players >= p are assigned
+  //
+  std::vector<double> vRemainingMax;
+
+  //
+  // Range of indices explored for each player, and its prefix sums used
+  // to keep the total index reachable by the players not yet assigned
+  //
+  std::vector<int> vLow;
+  std::vector<int> vHigh;
+  std::vector<int> vSumLow;
+  std::vector<int> vSumHigh;
+  std::vector<int> vBestIndex;
+
+  double LogReference;
+  double PruningMargin;
+  int Threads;
+
+  void BuildPairTables();
+  double LogLikelihood(const int *pindex) const;
+  void ComputeLogReference();
+  void ComputeWindows();
+  void RecursiveJointBayesian(int player,
+                              int indexTotal,
+                              double LogP,
+                              int *pindex,
+                              CDistributionCollection &dcLocal) const;
 
 public:  ///////////////////////////////////////////////////////////////////
   CJointBayesian(const CResultSet &rsInit,
                  CDistributionCollection &dcInit,
                  const CBradleyTerry &btInit);
 
+  //
+  // Skip subtrees whose log-likelihood falls more than Margin below
+  // that of the current ratings (0 = exact computation)
+  //
+  void SetPruningMargin(double Margin) {PruningMargin = Margin;}
+  void SetThreads(int n) {Threads = n > 0 ? n : 1;}
+
   void RunComputation();
 
   ~CJointBayesian();
@@ -9,6 +9,7 @@
 ////////////////////////////////////////////////////////////////////////////
 #include "./CResultSetCUI.h"
 
+#include <cmath>
 #include <iostream>  // NOLINT(readability/streams)
 #include <iomanip>
 #include <sstream>
@@ -19,8 +20,13 @@
 
 #include "./CResultSet.h"
 #include "./CCondensedResults.h"
+#include "./CResultStore.h"
+#include "./CBradleyTerry.h"
+#include "./clktimer.h"
+#include "./CTimeIO.h"
 #include "./CEloRatingCUI.h"
 #include "./EloDataFromFile.h"
+#include "./EloDataFromMappedFiles.h"
 #include "./pgnlex.h"
 #include "./pgn.h"
 #include "./debug.h"
@@ -61,9 +67,11 @@ const char * const CResultSetCUI::tszCommands[] = {
   "removerare",
   "pack",
   "readpgn",
+  "loadpgn",
   "gen",
   "connect",
   "elo",
+  "store",
   0
 };
 
@@ -99,9 +107,11 @@ int CResultSetCUI::ProcessCommand(const char *pszCommand,
     IDC_RemoveRare,
     IDC_Pack,
     IDC_ReadPGN,
+    IDC_LoadPGN,
     IDC_Gen,
     IDC_Connect,
-    IDC_Elo
+    IDC_Elo,
+    IDC_Store
   };
 
   switch (ArrayLookup(pszCommand, tszCommands)) {
@@ -123,9 +133,11 @@ int CResultSetCUI::ProcessCommand(const char *pszCommand,
       out << "removerare n .... remove games of players with less than n games\n";
       out << "pack ............ pack players (remove players with 0 games)\n";
       out << "readpgn <file>... read PGN file\n";
+      out << "loadpgn <f> [...] fast parallel load of PGN files (tags only)\n";
       out << "connect [p] [fr]  remove players not connected to p [fr=forbidden result]\n";
       out << '\n';
       out << "elo ............. open Elo-estimation interface\n";
+      out << "store <file> .... move results to a rating store, update its ratings\n";
       out << '\n';
       break;
 
@@ -282,6 +294,16 @@ int CResultSetCUI::ProcessCommand(const char *pszCommand,
     }
       break;
 
+    case IDC_LoadPGN: {  ////////////////////////////////////////////////////////
+      std::vector<std::string> vFileName;
+      std::istringstream is(pszParameters);
+      std::string sFileName;
+      while (is >> sFileName)
+        vFileName.push_back(sFileName);
+      EloDataFromMappedFiles(vFileName, rs, vecName);
+    }
+      break;
+
     case IDC_Gen: {  ////////////////////////////////////////////////////////////
       int Games = 0;
       std::vector<double> velo;
@@ -324,6 +346,61 @@ int CResultSetCUI::ProcessCommand(const char *pszCommand,
     }
       break;
 
+    case IDC_Store: {  //////////////////////////////////////////////////////////
+      //
+      // Merge current results into the store
+      //
+      CResultStore rst;
+      if (!rst.Read(pszParameters))
+        out << "Creating new store " << pszParameters << '\n';
+      rst.AddResults(rs, vecName);
+
+      //
+      // MM from the previous ratings, with the default prior of 2 draws
+      //
+      CCondensedResults crs(rst);
+      crs.AddPrior(2.0);
+      CBradleyTerry bt(crs);
+      for (int i = rst.GetPlayers(); --i >= 0;)
+        bt.SetElo(i, rst.GetElo(i));
+      bt.SetAdvantage(rst.GetAdvantage());
+      bt.SetDrawElo(rst.GetDrawElo());
+      CClockTimer timer;
+      bt.MinorizationMaximization(0, 0, 1e-5, 1);
+      out << timer.GetInterval() << '\n';
+      for (int i = rst.GetPlayers(); --i >= 0;)
+        rst.SetElo(i, bt.GetElo(i));
+
+      if (!rst.Write(pszParameters)) {
+        out << "Error: could not write " << pszParameters << '\n';
+        break;
+      }
+
+      //
+      // The games are in the store now: forget them, so that storing
+      // again does not count them twice
+      //
+      rs.Reset();
+      vecName.clear();
+
+      //
+      // Print ratings, scaled like the elo interface does after mm
+      //
+      double EloScale;
+      {
+        double x = std::pow(10.0, -rst.GetDrawElo() / 400);
+        EloScale = x * 4.0 / ((1 + x) * (1 + x));
+      }
+      std::vector<double> velo(rst.GetPlayers());
+      for (int i = rst.GetPlayers(); --i >= 0;)
+        velo[i] = rst.GetElo(i);
+      CCondensedResults crsNoPrior(rst);
+      CEloRatingCUI::PrintRatings(out, crs, crsNoPrior, rst.GetNames(),
+                                  &velo[0], EloScale, 0, 0, 0);
+      out << rst.CountGames() << " game(s) in store\n";
+    }
+      break;
+
     default:  /////////////////////////////////////////////////////////////////
       return CConsoleUI::ProcessCommand(pszCommand, pszParameters, in, out);
   }
@@ -0,0 +1,186 @@
+// Copyright (c) 2015 MIT License by 6.172 Staff
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// CResultStore.cpp
+//
+// File layout (host byte order):
+//   magic, version, players, pairs
+//   for each player: name length, name bytes, elo
+//   eloAdvantage, eloDraw
+//   for each pair: White, Black, w, d, l
+//
+/////////////////////////////////////////////////////////////////////////////
+#include "./CResultStore.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "./CResultSet.h"
+
+static const char szMagic[8] = {'B', 'E', 'L', 'O', 'S', 'T', 'O', 'R'};
+static const uint32_t Version = 1;
+
+/////////////////////////////////////////////////////////////////////////////
+// Binary I/O helpers
+/////////////////////////////////////////////////////////////////////////////
+template<class T>
+static void WriteValue(std::ostream &out, const T &x) {
+  out.write(reinterpret_cast<const char *>(&x), sizeof(x));
+}
+
+template<class T>
+static int ReadValue(std::istream &in, T &x) {
+  in.read(reinterpret_cast<char *>(&x), sizeof(x));
+  return static_cast<bool>(in);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Constructor
+/////////////////////////////////////////////////////////////////////////////
+CResultStore::CResultStore()
+    : eloAdvantage(32.8),
+      eloDraw(97.3) {
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Find a player by name, add it with a rating of 0 if it is new
+/////////////////////////////////////////////////////////////////////////////
+int CResultStore::FindOrAddPlayer(const std::string &sName) {
+  std::pair<std::unordered_map<std::string, int>::iterator, bool> Pair =
+      NameMap.insert(std::make_pair(sName, int(vName.size())));
+  if (Pair.second) {
+    vName.push_back(sName);
+    velo.push_back(0.0);
+  }
+  return Pair.first->second;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Find the counts of a (white, black) pair, add them if they are new
+/////////////////////////////////////////////////////////////////////////////
+CPairResults &CResultStore::FindOrAddPair(uint32_t White, uint32_t Black) {
+  std::pair<std::unordered_map<uint64_t, int>::iterator, bool> Pair =
+      PairMap.insert(std::make_pair(PairKey(White, Black), int(vPair.size())));
+  if (Pair.second) {
+    CPairResults pr;
+    pr.White = White;
+    pr.Black = Black;
+    pr.w = pr.d = pr.l = 0;
+    vPair.push_back(pr);
+  }
+  return vPair[Pair.first->second];
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Merge a set of results, with player numbers relative to vNames
+/////////////////////////////////////////////////////////////////////////////
+void CResultStore::AddResults(const CResultSet &rs,
+                              const std::vector<std::string> &vNames) {
+  std::vector<int> vIndex(vNames.size());
+  for (unsigned i = 0; i < vNames.size(); i++)
+    vIndex[i] = FindOrAddPlayer(vNames[i]);
+
+  for (int i = 0; i < rs.GetGames(); i++) {
+    CPairResults &pr = FindOrAddPair(vIndex[rs.GetWhite(i)],
+                                     vIndex[rs.GetBlack(i)]);
+    switch (rs.GetResult(i)) {
+      case 0: pr.l++; break;
+      case 1: pr.d++; break;
+      case 2: pr.w++; break;
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Total number of games
+/////////////////////////////////////////////////////////////////////////////
+int64_t CResultStore::CountGames() const {
+  int64_t Result = 0;
+  for (int i = vPair.size(); --i >= 0;)
+    Result += vPair[i].Games();
+  return Result;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Read from a file, returns 0 if the file is missing or invalid
+/////////////////////////////////////////////////////////////////////////////
+int CResultStore::Read(const char *pszFileName) {
+  std::ifstream ifs(pszFileName, std::ios::in | std::ios::binary);
+  if (!ifs)
+    return 0;
+
+  char szFileMagic[sizeof(szMagic)];
+  uint32_t FileVersion = 0;
+  uint32_t Players = 0;
+  uint32_t Pairs = 0;
+  ifs.read(szFileMagic, sizeof(szFileMagic));
+  if (!ifs || memcmp(szFileMagic, szMagic, sizeof(szMagic)) ||
+      !ReadValue(ifs, FileVersion) || FileVersion != Version ||
+      !ReadValue(ifs, Players) || !ReadValue(ifs, Pairs))
+    return 0;
+
+  CResultStore rst;
+  for (uint32_t i = 0; i < Players; i++) {
+    uint32_t Length = 0;
+    double elo = 0;
+    if (!ReadValue(ifs, Length))
+      return 0;
+    std::string sName(Length, ' ');
+    if (Length > 0)
+      ifs.read(&sName[0], Length);
+    if (!ReadValue(ifs, elo))
+      return 0;
+    rst.SetElo(rst.FindOrAddPlayer(sName), elo);
+  }
+
+  if (!ReadValue(ifs, rst.eloAdvantage) || !ReadValue(ifs, rst.eloDraw))
+    return 0;
+
+  for (uint32_t i = 0; i < Pairs; i++) {
+    CPairResults pr;
+    if (!ReadValue(ifs, pr) || pr.White >= Players || pr.Black >= Players)
+      return 0;
+    rst.FindOrAddPair(pr.White, pr.Black) = pr;
+  }
+
+  *this = rst;
+  return 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Write to a file, returns 0 in case of error
+// The file is replaced atomically, so a failed run keeps the old store.
+/////////////////////////////////////////////////////////////////////////////
+int CResultStore::Write(const char *pszFileName) const {
+  std::string sTempName = std::string(pszFileName) + ".tmp";
+  std::ofstream ofs(sTempName.c_str(),
+                    std::ios::out | std::ios::binary | std::ios::trunc);
+
+  ofs.write(szMagic, sizeof(szMagic));
+  WriteValue(ofs, Version);
+  WriteValue(ofs, uint32_t(vName.size()));
+  WriteValue(ofs, uint32_t(vPair.size()));
+
+  for (unsigned i = 0; i < vName.size(); i++) {
+    WriteValue(ofs, uint32_t(vName[i].size()));
+    ofs.write(vName[i].data(), vName[i].size());
+    WriteValue(ofs, velo[i]);
+  }
+
+  WriteValue(ofs, eloAdvantage);
+  WriteValue(ofs, eloDraw);
+
+  for (unsigned i = 0; i < vPair.size(); i++)
+    WriteValue(ofs, vPair[i]);
+
+  ofs.close();
+  if (!ofs || std::rename(sTempName.c_str(), pszFileName)) {
+    std::remove(sTempName.c_str());
+    return 0;
+  }
+  return 1;
+}
@@ -0,0 +1,80 @@
+// Copyright (c) 2015 MIT License by 6.172 Staff
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// CResultStore.h
+//
+// Persistent summary of a game history: pairwise win/draw/loss counts for
+// each (white, black) pair of players, with the last computed ratings.
+// New games are merged in without replaying the history, and the stored
+// ratings are used to warm-start MM.
+//
+/////////////////////////////////////////////////////////////////////////////
+#ifndef CResultStore_Declared
+#define CResultStore_Declared
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class CResultSet;
+
+class CPairResults {  // pr
+ public:
+  uint32_t White;
+  uint32_t Black;
+  uint32_t w;  // white wins
+  uint32_t d;
+  uint32_t l;  // white losses
+
+  uint32_t Games() const {return w + d + l;}
+};
+
+class CResultStore {  // rst
+private:  ///////////////////////////////////////////////////////////////////
+  std::vector<std::string> vName;
+  std::unordered_map<std::string, int> NameMap;
+  std::vector<CPairResults> vPair;
+  std::unordered_map<uint64_t, int> PairMap;
+  std::vector<double> velo;
+  double eloAdvantage;
+  double eloDraw;
+
+  static uint64_t PairKey(uint32_t White, uint32_t Black) {
+    return (uint64_t(White) << 32) | Black;
+  }
+
+  CPairResults &FindOrAddPair(uint32_t White, uint32_t Black);
+
+public:  ////////////////////////////////////////////////////////////////////
+  CResultStore();
+
+  int Read(const char *pszFileName);
+  int Write(const char *pszFileName) const;
+
+  int FindOrAddPlayer(const std::string &sName);
+  void AddResults(const CResultSet &rs, const std::vector<std::string> &vNames);
+
+  //
+  // Gets
+  //
+  int GetPlayers() const {return vName.size();}
+  int GetPairs() const {return vPair.size();}
+  const CPairResults &GetPair(int i) const {return vPair[i];}
+  const std::string &GetName(int i) const {return vName[i];}
+  const std::vector<std::string> &GetNames() const {return vName;}
+  double GetElo(int i) const {return velo[i];}
+  double GetAdvantage() const {return eloAdvantage;}
+  double GetDrawElo() const {return eloDraw;}
+  int64_t CountGames() const;
+
+  //
+  // Sets
+  //
+  void SetElo(int i, double x) {velo[i] = x;}
+  void SetAdvantage(double x) {eloAdvantage = x;}
+  void SetDrawElo(double x) {eloDraw = x;}
+};
+
+#endif  // CResultStore_Declared
@@ -0,0 +1,186 @@
+// Copyright (c) 2015 MIT License by 6.172 Staff
+
+////////////////////////////////////////////////////////////////////////////
+//
+// CSparseCholesky.cpp
+//
+////////////////////////////////////////////////////////////////////////////
+#include "./CSparseCholesky.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////
+// Constructor: ordering and envelope
+////////////////////////////////////////////////////////////////////////////
+CSparseCholesky::CSparseCholesky(
+    const std::vector<std::vector<int> > &vvNeighbour)
+    : n(vvNeighbour.size()),
+      vOrder(n),
+      vPosition(n, -1),
+      vFirst(n),
+      vRowStart(n + 1) {
+  //
+  // Cuthill-McKee: breadth-first from a vertex of minimum degree,
+  // neighbours in increasing degree, restarting for each component
+  //
+  std::vector<int> vByDegree(n);
+  for (int i = n; --i >= 0;)
+    vByDegree[i] = i;
+  std::stable_sort(vByDegree.begin(), vByDegree.end(),
+                   [&vvNeighbour](int a, int b) {
+                     return vvNeighbour[a].size() < vvNeighbour[b].size();
+                   });
+
+  int Ordered = 0;
+  std::vector<int> vNext;
+  for (int s = 0; s < n; s++) {
+    int Start = vByDegree[s];
+    if (vPosition[Start] >= 0)
+      continue;
+    int Head = Ordered;
+    vPosition[Start] = Ordered;
+    vOrder[Ordered++] = Start;
+    while (Head < Ordered) {
+      int v = vOrder[Head++];
+      vNext.clear();
+      for (unsigned k = 0; k < vvNeighbour[v].size(); k++) {
+        int w = vvNeighbour[v][k];
+        if (vPosition[w] < 0) {
+          vPosition[w] = 0;
+          vNext.push_back(w);
+        }
+      }
+      std::stable_sort(vNext.begin(), vNext.end(),
+                       [&vvNeighbour](int a, int b) {
+                         return vvNeighbour[a].size() < vvNeighbour[b].size();
+                       });
+      for (unsigned k = 0; k < vNext.size(); k++) {
+        vPosition[vNext[k]] = Ordered;
+        vOrder[Ordered++] = vNext[k];
+      }
+    }
+  }
+
+  //
+  // Reverse it (RCM usually has a smaller envelope)
+  //
+  std::reverse(vOrder.begin(), vOrder.end());
+  for (int i = n; --i >= 0;)
+    vPosition[vOrder[i]] = i;
+
+  //
+  // Envelope of each row
+  //
+  vRowStart[0] = 0;
+  for (int i = 0; i < n; i++) {
+    int First = i;
+    const std::vector<int> &vNeighbour = vvNeighbour[vOrder[i]];
+    for (unsigned k = 0; k < vNeighbour.size(); k++)
+      if (vPosition[vNeighbour[k]] < First)
+        First = vPosition[vNeighbour[k]];
+    vFirst[i] = First;
+    vRowStart[i + 1] = vRowStart[i] + (i - First + 1);
+  }
+  vL.assign(vRowStart[n], 0.0);
+}
+
+////////////////////////////////////////////////////////////////////////////
+// Set an element of the matrix, in original numbering
+////////////////////////////////////////////////////////////////////////////
+void CSparseCholesky::SetElement(int i, int j, double x) {
+  int pi = vPosition[i];
+  int pj = vPosition[j];
+  if (pj > pi)
+    std::swap(pi, pj);
+  L(pi, pj) = x;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// Decompose in place, row by row
+////////////////////////////////////////////////////////////////////////////
+int CSparseCholesky::Decompose() {
+  for (int i = 0; i < n; i++) {
+    double *pRow = &vL[vRowStart[i]] - vFirst[i];
+
+    for (int j = vFirst[i]; j < i; j++) {
+      const double *pRowJ = &vL[vRowStart[j]] - vFirst[j];
+      int kMin = std::max(vFirst[i], vFirst[j]);
+      double Sum = pRow[j];
+      for (int k = kMin; k < j; k++)
+        Sum -= pRow[k] * pRowJ[k];
+      pRow[j] = Sum / pRowJ[j];
+    }
+
+    double Sum = pRow[i];
+    for (int k = vFirst[i]; k < i; k++)
+      Sum -= pRow[k] * pRow[k];
+    if (!(Sum > 0))
+      return 0;
+    pRow[i] = std::sqrt(Sum);
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// Solve A x = b (original numbering)
+////////////////////////////////////////////////////////////////////////////
+void CSparseCholesky::Solve(const double *pb, double *px) const {
+  std::vector<double> vy(n);
+  for (int i = 0; i < n; i++)
+    vy[i] = pb[vOrder[i]];
+
+  //
+  // Forward: L y = b
+  //
+  for (int i = 0; i < n; i++) {
+    const double *pRow = &vL[vRowStart[i]] - vFirst[i];
+    double Sum = vy[i];
+    for (int k = vFirst[i]; k < i; k++)
+      Sum -= pRow[k] * vy[k];
+    vy[i] = Sum / pRow[i];
+  }
+
+  //
+  // Backward: L^T x = y
+  //
+  for (int i = n; --i >= 0;) {
+    const double *pRow = &vL[vRowStart[i]] - vFirst[i];
+    double x = vy[i] / pRow[i];
+    vy[i] = x;
+    for (int k = vFirst[i]; k < i; k++)
+      vy[k] -= pRow[k] * x;
+  }
+
+  for (int i = n; --i >= 0;)
+    px[vOrder[i]] = vy[i];
+}
+
+////////////////////////////////////////////////////////////////////////////
+// Solve A x = e_j, where the forward pass can skip leading zeros
+////////////////////////////////////////////////////////////////////////////
+void CSparseCholesky::SolveUnit(int j, double *px) const {
+  std::vector<double> vy(n, 0.0);
+  int Start = vPosition[j];
+  vy[Start] = 1.0;
+
+  for (int i = Start; i < n; i++) {
+    const double *pRow = &vL[vRowStart[i]] - vFirst[i];
+    double Sum = vy[i];
+    for (int k = std::max(vFirst[i], Start); k < i; k++)
+      Sum -= pRow[k] * vy[k];
+    vy[i] = Sum / pRow[i];
+  }
+
+  for (int i = n; --i >= 0;) {
+    const double *pRow = &vL[vRowStart[i]] - vFirst[i];
+    double x = vy[i] / pRow[i];
+    vy[i] = x;
+    for (int k = vFirst[i]; k < i; k++)
+      vy[k] -= pRow[k] * x;
+  }
+
+  for (int i = n; --i >= 0;)
+    px[vOrder[i]] = vy[i];
+}
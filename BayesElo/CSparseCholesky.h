@@ -0,0 +1,51 @@
+// Copyright (c) 2015 MIT License by 6.172 Staff
+
+////////////////////////////////////////////////////////////////////////////
+//
+// CSparseCholesky.h
+//
+// Cholesky decomposition of a sparse symmetric positive-definite matrix.
+// Rows are reordered with reverse Cuthill-McKee to keep non-zeros close
+// to the diagonal, and the factor is stored by rows over the envelope
+// (from the first non-zero of each row to the diagonal), so that fill-in
+// stays inside contiguous rows.
+//
+////////////////////////////////////////////////////////////////////////////
+#ifndef Math_CSparseCholesky_Declared
+#define Math_CSparseCholesky_Declared
+
+#include <cstddef>
+#include <vector>
+
+class CSparseCholesky {  // spc
+private:  /////////////////////////////////////////////////////////////////
+  int n;
+  std::vector<int> vOrder;     // vOrder[position] = original index
+  std::vector<int> vPosition;  // vPosition[original index] = position
+  std::vector<int> vFirst;     // first column of the envelope of each row
+  std::vector<size_t> vRowStart;
+  std::vector<double> vL;
+
+  double &L(int i, int j) {return vL[vRowStart[i] + j - vFirst[i]];}
+  double L(int i, int j) const {return vL[vRowStart[i] + j - vFirst[i]];}
+
+public:  //////////////////////////////////////////////////////////////////
+  //
+  // vvNeighbour[i] lists the j != i with a non-zero element (i, j)
+  //
+  CSparseCholesky(const std::vector<std::vector<int> > &vvNeighbour);
+
+  size_t GetEnvelopeSize() const {return vL.size();}
+
+  //
+  // Elements must be set (for j <= i, or both triangles with the same
+  // value) before Decompose, which returns 0 if the matrix is not
+  // positive definite
+  //
+  void SetElement(int i, int j, double x);
+  int Decompose();
+  void Solve(const double *pb, double *px) const;
+  void SolveUnit(int j, double *px) const;
+};
+
+#endif  // Math_CSparseCholesky_Declared
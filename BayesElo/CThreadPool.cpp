@@ -0,0 +1,109 @@
+// Copyright (c) 2015 MIT License by 6.172 Staff
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// CThreadPool.cpp
+//
+/////////////////////////////////////////////////////////////////////////////
+#include "./CThreadPool.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// Number of threads to use when the user did not choose
+/////////////////////////////////////////////////////////////////////////////
+int CThreadPool::DefaultThreads() {
+  int n = static_cast<int>(std::thread::hardware_concurrency());
+  return n > 0 ? n : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Claim and run tasks of the current batch until none are left
+/////////////////////////////////////////////////////////////////////////////
+void CThreadPool::RunTasks() {
+  for (;;) {
+    int i = NextTask.fetch_add(1, std::memory_order_relaxed);
+    if (i >= Tasks)
+      break;
+    (*pTask)(i);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Worker thread
+/////////////////////////////////////////////////////////////////////////////
+void CThreadPool::WorkerLoop() {
+  unsigned SeenGeneration = 0;
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      cvStart.wait(lock, [&] {
+        return fQuit || Generation != SeenGeneration;
+      });
+      if (fQuit)
+        return;
+      SeenGeneration = Generation;
+    }
+
+    RunTasks();
+
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (--Running == 0)
+        cvDone.notify_one();
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Constructor
+/////////////////////////////////////////////////////////////////////////////
+CThreadPool::CThreadPool(int Threads)
+    : pTask(0),
+      Tasks(0),
+      NextTask(0),
+      Running(0),
+      Generation(0),
+      fQuit(false) {
+  for (int i = 1; i < Threads; i++)
+    vThread.push_back(std::thread(&CThreadPool::WorkerLoop, this));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Run a batch of tasks
+/////////////////////////////////////////////////////////////////////////////
+void CThreadPool::Run(int n, const std::function<void(int)> &f) {
+  if (vThread.empty() || n <= 1) {
+    for (int i = 0; i < n; i++)
+      f(i);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    pTask = &f;
+    Tasks = n;
+    NextTask.store(0, std::memory_order_relaxed);
+    Running = static_cast<int>(vThread.size());
+    Generation++;
+  }
+  cvStart.notify_all();
+
+  RunTasks();
+
+  std::unique_lock<std::mutex> lock(mtx);
+  cvDone.wait(lock, [&] {return Running == 0;});
+  pTask = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Destructor
+/////////////////////////////////////////////////////////////////////////////
+CThreadPool::~CThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    fQuit = true;
+  }
+  cvStart.notify_all();
+  for (unsigned i = 0; i < vThread.size(); i++)
+    vThread[i].join();
+}
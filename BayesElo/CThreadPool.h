@@ -0,0 +1,53 @@
+// Copyright (c) 2015 MIT License by 6.172 Staff
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// CThreadPool.h
+//
+// Fixed set of worker threads that run indexed tasks in parallel.
+// The calling thread takes part in every Run, so a pool of n threads
+// only creates n - 1 workers.
+//
+/////////////////////////////////////////////////////////////////////////////
+#ifndef CThreadPool_Declared
+#define CThreadPool_Declared
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CThreadPool {  // tp
+private:  ///////////////////////////////////////////////////////////////////
+  std::vector<std::thread> vThread;
+  std::mutex mtx;
+  std::condition_variable cvStart;
+  std::condition_variable cvDone;
+
+  const std::function<void(int)> *pTask;
+  int Tasks;
+  std::atomic<int> NextTask;
+  int Running;
+  unsigned Generation;
+  bool fQuit;
+
+  void RunTasks();
+  void WorkerLoop();
+
+public:  ////////////////////////////////////////////////////////////////////
+  explicit CThreadPool(int Threads);
+  ~CThreadPool();
+
+  int GetThreads() const {return static_cast<int>(vThread.size()) + 1;}
+
+  //
+  // Call f(i) for i in [0, n) and wait until all calls are done
+  //
+  void Run(int n, const std::function<void(int)> &f);
+
+  static int DefaultThreads();
+};
+
+#endif  // CThreadPool_Declared
@@ -0,0 +1,345 @@
+// Copyright (c) 2015 MIT License by 6.172 Staff
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// EloDataFromMappedFiles.cpp
+//
+/////////////////////////////////////////////////////////////////////////////
+#include "./EloDataFromMappedFiles.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>  // NOLINT(readability/streams)
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "./pgn.h"
+#include "./str.h"
+#include "./CResultSet.h"
+#include "./CThreadPool.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// Files are cut into chunks of about this size for parallel scanning
+/////////////////////////////////////////////////////////////////////////////
+static const size_t ChunkSize = size_t(1) << 26;
+
+/////////////////////////////////////////////////////////////////////////////
+// CSTR keeps at most 63 characters of player names
+/////////////////////////////////////////////////////////////////////////////
+static const size_t MaxNameLength = 63;
+
+/////////////////////////////////////////////////////////////////////////////
+// A mapped file
+/////////////////////////////////////////////////////////////////////////////
+class CMappedFile {  // mf
+ public:
+  const char *pData;
+  size_t Size;
+
+  CMappedFile(): pData(0), Size(0) {}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// Games found in one chunk, with player numbers local to the chunk
+/////////////////////////////////////////////////////////////////////////////
+class CChunkGames {  // cg
+ public:
+  const char *pBegin;
+  const char *pEnd;
+
+  std::vector<std::string> vName;
+  std::vector<int> vWhite;
+  std::vector<int> vBlack;
+  std::vector<int> vResult;
+  int Ignored;
+
+  CChunkGames(const char *pb, const char *pe)
+      : pBegin(pb), pEnd(pe), Ignored(0) {}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// Map a file in memory
+/////////////////////////////////////////////////////////////////////////////
+static int MapFile(const std::string &sFileName, CMappedFile &mf) {
+  int fd = open(sFileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    return 0;
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return 0;
+  }
+
+  mf.Size = st.st_size;
+  if (mf.Size > 0) {
+    void *p = mmap(0, mf.Size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      close(fd);
+      return 0;
+    }
+    madvise(p, mf.Size, MADV_SEQUENTIAL);
+    mf.pData = static_cast<const char *>(p);
+  }
+
+  close(fd);
+  return 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Skip movetext from p, at a line start, to the next line that starts with
+// '[' outside a comment.  As in CPGNLex, a comment runs from '{' to the
+// first '}', or from ';' to the end of the line.
+/////////////////////////////////////////////////////////////////////////////
+static const char *SkipMovetext(const char *p, const char *pEnd) {
+  while (p < pEnd) {
+    const char *q;
+    switch (*p) {
+      case '{':
+        q = static_cast<const char *>(memchr(p + 1, '}', pEnd - p - 1));
+        if (!q)
+          return pEnd;
+        p = q + 1;
+        break;
+      case ';':
+        q = static_cast<const char *>(memchr(p, '\n', pEnd - p));
+        if (!q)
+          return pEnd;
+        p = q;
+        break;
+      case '\n':
+        if (++p < pEnd && *p == '[')
+          return p;
+        break;
+      default:
+        p++;
+    }
+  }
+  return pEnd;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Find the first tag section that starts at or after pTarget, walking games
+// from p, the start of the file or of a tag section.  Walking from there is
+// what tells a tag line from a comment line that happens to begin with '['.
+/////////////////////////////////////////////////////////////////////////////
+static const char *NextGameStart(const char *p,
+                                 const char *pTarget,
+                                 const char *pEnd) {
+  while (p < pEnd) {
+    while (p < pEnd && *p == '[') {
+      const char *pEol =
+          static_cast<const char *>(memchr(p, '\n', pEnd - p));
+      if (!pEol)
+        return pEnd;
+      p = pEol + 1;
+    }
+    p = SkipMovetext(p, pEnd);
+    if (p >= pTarget)
+      return p;
+  }
+  return pEnd;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Parse one tag line, from just after '[' to the end of the line
+/////////////////////////////////////////////////////////////////////////////
+static void ParseTag(const char *p,
+                     const char *pEol,
+                     std::string &sWhite,
+                     std::string &sBlack,
+                     int &Result) {
+  while (p < pEol && (*p == ' ' || *p == '\t'))
+    p++;
+  const char *pSymbol = p;
+  while (p < pEol && *p != ' ' && *p != '\t' && *p != '"')
+    p++;
+  size_t SymbolLength = p - pSymbol;
+
+  int Tag;
+  if (SymbolLength == 5 && !memcmp(pSymbol, "White", 5))
+    Tag = CPGN::TAG_White;
+  else if (SymbolLength == 5 && !memcmp(pSymbol, "Black", 5))
+    Tag = CPGN::TAG_Black;
+  else if (SymbolLength == 6 && !memcmp(pSymbol, "Result", 6))
+    Tag = CPGN::TAG_Result;
+  else
+    return;
+
+  const char *pQuote =
+      static_cast<const char *>(memchr(p, '"', pEol - p));
+  if (!pQuote)
+    return;
+
+  std::string sValue;
+  for (p = pQuote + 1; p < pEol && *p != '"'; p++) {
+    if (*p == '\\' && p + 1 < pEol)
+      p++;
+    sValue += *p;
+  }
+  if (sValue.size() > MaxNameLength)
+    sValue.resize(MaxNameLength);
+
+  switch (Tag) {
+    case CPGN::TAG_White: sWhite = sValue; break;
+    case CPGN::TAG_Black: sBlack = sValue; break;
+    case CPGN::TAG_Result:
+      for (Result = CSTR::Results; --Result >= 0;)
+        if (sValue == CPGN::tszResult[Result])
+          break;
+      if (Result < 0)
+        Result = CSTR::Unknown;
+      break;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Record the game of a complete tag section
+/////////////////////////////////////////////////////////////////////////////
+static void AddGame(CChunkGames &cg,
+                    std::unordered_map<std::string, int> &NameMap,
+                    const std::string &sWhite,
+                    const std::string &sBlack,
+                    int Result) {
+  if (Result < CSTR::BlackWins || Result > CSTR::WhiteWins) {
+    cg.Ignored++;
+    return;
+  }
+
+  int Player[2];
+  const std::string *ps[2] = {&sWhite, &sBlack};
+  for (int i = 0; i < 2; i++) {
+    std::pair<std::unordered_map<std::string, int>::iterator, bool> Pair =
+        NameMap.insert(std::make_pair(*ps[i], int(cg.vName.size())));
+    if (Pair.second)
+      cg.vName.push_back(*ps[i]);
+    Player[i] = Pair.first->second;
+  }
+
+  cg.vWhite.push_back(Player[0]);
+  cg.vBlack.push_back(Player[1]);
+  cg.vResult.push_back(Result);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Scan a chunk: read tag lines, jump over movetext and its comments
+/////////////////////////////////////////////////////////////////////////////
+static void ScanChunk(CChunkGames &cg) {
+  std::unordered_map<std::string, int> NameMap;
+  std::string sWhite;
+  std::string sBlack;
+  int Result = CSTR::Unknown;
+  int fInTags = 0;
+
+  const char *p = cg.pBegin;
+  const char *pEnd = cg.pEnd;
+
+  while (p < pEnd) {
+    if (*p == '[') {
+      if (!fInTags) {
+        sWhite.clear();
+        sBlack.clear();
+        Result = CSTR::Unknown;
+        fInTags = 1;
+      }
+      const char *pEol =
+          static_cast<const char *>(memchr(p, '\n', pEnd - p));
+      if (!pEol)
+        pEol = pEnd;
+      ParseTag(p + 1, pEol, sWhite, sBlack, Result);
+      p = pEol + 1;
+    } else {
+      if (fInTags) {
+        AddGame(cg, NameMap, sWhite, sBlack, Result);
+        fInTags = 0;
+      }
+
+      p = SkipMovetext(p, pEnd);
+    }
+  }
+
+  if (fInTags)
+    AddGame(cg, NameMap, sWhite, sBlack, Result);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Read all data for Elo calculation from a list of PGN files
+// Returns the number of files that could be read
+/////////////////////////////////////////////////////////////////////////////
+int EloDataFromMappedFiles(const std::vector<std::string> &vFileName,
+                           CResultSet &rs,
+                           std::vector<std::string> &vNames) {
+  //
+  // Map files and cut them into chunks that start on a tag section
+  //
+  std::vector<CMappedFile> vmf(vFileName.size());
+  std::vector<CChunkGames> vcg;
+  int Files = 0;
+
+  for (unsigned i = 0; i < vFileName.size(); i++) {
+    if (!MapFile(vFileName[i], vmf[i])) {
+      std::cerr << "Error: could not read " << vFileName[i] << '\n';
+      continue;
+    }
+    Files++;
+
+    const char *pBegin = vmf[i].pData;
+    const char *pEnd = pBegin + vmf[i].Size;
+    const char *p = pBegin;
+    while (p < pEnd) {
+      const char *pNext = pEnd;
+      if (size_t(pEnd - p) > ChunkSize)
+        pNext = NextGameStart(p, p + ChunkSize, pEnd);
+      vcg.push_back(CChunkGames(p, pNext));
+      p = pNext;
+    }
+  }
+
+  //
+  // Scan chunks in parallel
+  //
+  {
+    CThreadPool tp(CThreadPool::DefaultThreads());
+    tp.Run(vcg.size(), [&vcg](int i) {ScanChunk(vcg[i]);});
+  }
+
+  //
+  // Merge in order, so that players are numbered as with EloDataFromFile
+  //
+  std::unordered_map<std::string, int> NameMap;
+  for (int i = vNames.size(); --i >= 0;)
+    NameMap.insert(std::make_pair(vNames[i], i));
+
+  int Ignored = 0;
+  for (unsigned i = 0; i < vcg.size(); i++) {
+    const CChunkGames &cg = vcg[i];
+    std::vector<int> vPlayer(cg.vName.size());
+
+    for (unsigned j = 0; j < cg.vName.size(); j++) {
+      std::pair<std::unordered_map<std::string, int>::iterator, bool> Pair =
+          NameMap.insert(std::make_pair(cg.vName[j], int(vNames.size())));
+      if (Pair.second)
+        vNames.push_back(cg.vName[j]);
+      vPlayer[j] = Pair.first->second;
+    }
+
+    for (unsigned j = 0; j < cg.vResult.size(); j++)
+      rs.Append(vPlayer[cg.vWhite[j]], vPlayer[cg.vBlack[j]], cg.vResult[j]);
+
+    Ignored += cg.Ignored;
+  }
+
+  for (unsigned i = 0; i < vmf.size(); i++)
+    if (vmf[i].pData)
+      munmap(const_cast<char *>(vmf[i].pData), vmf[i].Size);
+
+  std::cerr << rs.GetGames() << " game(s) loaded, ";
+  std::cerr << Ignored << " game(s) with unknown result ignored.\n";
+
+  return Files;
+}
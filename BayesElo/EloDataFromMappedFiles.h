@@ -0,0 +1,24 @@
+// Copyright (c) 2015 MIT License by 6.172 Staff
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// EloDataFromMappedFiles.h
+//
+// Fast PGN loader: memory-maps files and reads only the White, Black and
+// Result tags, skipping movetext. Files are split into chunks that are
+// scanned in parallel; games are appended in file order.
+//
+/////////////////////////////////////////////////////////////////////////////
+#ifndef EloDataFromMappedFiles_Declared
+#define EloDataFromMappedFiles_Declared
+
+#include <vector>
+#include <string>
+
+class CResultSet;
+
+int EloDataFromMappedFiles(const std::vector<std::string> &vFileName,
+                           CResultSet &rs,
+                           std::vector<std::string> &vNames);
+
+#endif  // EloDataFromMappedFiles_Declared
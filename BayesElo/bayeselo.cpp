@@ -26,6 +26,8 @@
 #include "./CMatrix.cpp"
 #include "./CMatrixIO.cpp"
 #include "./CLUDecomposition.cpp"
+#include "./CSparseCholesky.cpp"
+#include "./CThreadPool.cpp"
 
 #include "./CBradleyTerry.cpp"
 #include "./CCDistribution.cpp"
@@ -36,8 +38,10 @@
 #include "./CEloRatingCUI.cpp"
 #include "./CJointBayesian.cpp"
 #include "./CResultSet.cpp"
+#include "./CResultStore.cpp"
 #include "./CResultSetCUI.cpp"
 #include "./EloDataFromFile.cpp"
+#include "./EloDataFromMappedFiles.cpp"
 #include "./CPredictionCUI.cpp"
 
 #include "./elomain.cpp"
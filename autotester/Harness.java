@@ -34,6 +34,8 @@ public class Harness {
     static String opening_book = "";
     static int game_rounds = 0;
     static int adjudicate = 400;             // default number of moves to adjudicate as a draw
+    static int[] resign = {0, 0};            // score adjudication: cp, moves
+    static int[] draw = {0, 0, 0};           // draw adjudication: after move, cp, moves
     static int totalPlayers = 0;
     static String[] sname = new String[512]; // map id to player name
     static int[] count = new int[512];       // how many games as white for each player?
@@ -56,7 +58,7 @@ public class Harness {
         Matcher         rm = rp.matcher("");
         String          w = "";
         String          b = "";
-        //        String          r = "";
+        String          r = "";
 
         try {
             FileReader fr = new FileReader( pgnfile );
@@ -75,12 +77,13 @@ public class Harness {
                 }
                 rm.reset(s);
                 if (rm.find()) {
-                    // r = rm.group(1);
+                    r = rm.group(1);
                     if (pl.containsKey(w) && pl.containsKey(b)) {
                         int idw = pl.get(w).id;
                         int idb = pl.get(b).id;
                         pl.get(w).count[idb] += 1;  // how many games against a given player
                         pl.get(b).count[idw] += 1;  // ditto
+                        Sprt.addResult(w, b, r, gn);
                         gn++;
                     }
                     continue;
@@ -400,10 +403,21 @@ public class Harness {
                         // need some kind of limit on this
                         if (adjudicate > 4000) adjudicate = 4000;
                         if (adjudicate < 2) adjudicate = 2;
+                    } else if (k.equals("resign")) {
+                        String[] mi = v.split("\\s+");
+                        resign[0] = Math.abs(Integer.parseInt(mi[0]));
+                        resign[1] = Integer.parseInt(mi[1]);
+                    } else if (k.equals("draw")) {
+                        String[] mi = v.split("\\s+");
+                        draw[0] = Integer.parseInt(mi[0]);
+                        draw[1] = Math.abs(Integer.parseInt(mi[1]));
+                        draw[2] = Integer.parseInt(mi[2]);
                     } else if (k.equals("book")) {
                         opening_book = new String(v);
                     } else if (k.equals("game_rounds")) {
                         game_rounds = Integer.parseInt(v);  // pairs of games
+                    } else if (k.equals("sprt")) {
+                        Sprt.configure(v);                  // elo0 elo1 [alpha beta]
                     } else if (k.equals("desc")) {
                         // PlayGame.desc = v;
                     } else if (k.equals("family")) {
@@ -498,6 +512,16 @@ public class Harness {
             }
         }
 
+        // SPRT compares the first player (candidate) against the second
+        // (baseline); the trace goes next to the PGN file
+        if (Sprt.enabled) {
+            if (totalPlayers != 2) {
+                System.out.printf("sprt requires exactly 2 players, found %d\n", totalPlayers);
+                System.exit(1);
+            }
+            Sprt.open(base + ".sprt", sname[0], sname[1]);
+        }
+
         parsePgn();
 
 
@@ -577,7 +601,7 @@ public class Harness {
                 Player w = pl.get( sname[pv >> 16] );
                 Player b = pl.get( sname[pv & 0xffff] );
                 long opn_ix = (w.count[b.id] / 2) % Book.count;  // which opening to play
-                if (opn_ix < Book.count && total_games+cpus < game_rounds) {
+                if (opn_ix < Book.count && total_games+cpus < game_rounds && !Sprt.decided()) {
                     System.out.println("opn_ix = "+opn_ix+", generate game round: "+(total_games+cpus));
 
                     total_games++;
@@ -597,6 +621,11 @@ public class Harness {
                     xx.setWhitePlayer(w);
                     xx.setBlackPlayer(b);
                     xx.drawMoves = adjudicate;
+                    xx.resignScore = resign[0];
+                    xx.resignCount = resign[1];
+                    xx.drawAfter = draw[0];
+                    xx.drawScore = draw[1];
+                    xx.drawCount = draw[2];
                     gn = gn + 1;
                     xx.begin();
                 } else {
@@ -636,6 +665,11 @@ public class Harness {
                 System.out.printf("%10d.%1d sec  %10d.%03d gpm  %8d games\n",
                                   (int)sec, (int)(10 * (sec - (int)sec)),  igpm, frac3, gn );
 
+                if (Sprt.enabled) {
+                    System.out.printf("%s\n", Sprt.verdict());
+                    Sprt.close();
+                }
+
                 // PlayGame.oldest();
                 System.out.printf("Finished ...\n");
                 return;
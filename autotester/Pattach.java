@@ -42,6 +42,11 @@ class Pattach {
     private Long     nodes_achieved = 0L;
     private Pattern  nodesp = Pattern.compile(" nodes (\\d+)");
     private Matcher  nodesm = nodesp.matcher("");
+    private Integer  score_achieved = null;    // null if not reported
+    private Pattern  scorep = Pattern.compile(" score cp (-?\\d+)");
+    private Matcher  scorem = scorep.matcher("");
+    private Pattern  multipvp = Pattern.compile(" multipv (\\d+)");
+    private Matcher  multipvm = multipvp.matcher("");
     private boolean hasdied = false;
 
     public void snd(String s)
@@ -106,6 +111,12 @@ class Pattach {
         return nodes_achieved;
     }
 
+    // last best-line score reported while waiting, from the mover's view
+    public Integer scoreAchieved()
+    {
+        return score_achieved;
+    }
+
     // static String[] sname = new String[512]; // map id to player name
     public String[] getOpts()
     {
@@ -143,6 +154,7 @@ class Pattach {
 
         if (hasdied) return "hasdied";
 
+        score_achieved = null;
         while (true) {
             try {
                 s = br.readLine();
@@ -173,6 +185,14 @@ class Pattach {
                 nodes_achieved = Long.parseLong(nodesm.group(1));
             }
 
+            // with multipv, only the best line's score counts
+            scorem.reset(s);
+            multipvm.reset(s);
+            if (scorem.find() && (!multipvm.find()
+                                  || Integer.parseInt(multipvm.group(1)) == 1)) {
+                score_achieved = Integer.parseInt(scorem.group(1));
+            }
+
             if (s.length() >= w.length()) {
                 if (s.substring(0, x).equals(w)) {
                     return s;
@@ -33,6 +33,11 @@ public class PlayGame implements Runnable
     private Pattach  pW = new Pattach();
     private Pattach  pB = new Pattach();
     public  Integer  drawMoves;
+    public  int      resignScore = 0;  // score adjudication: |cp| both sides agree on, 0 = off
+    public  int      resignCount = 0;  // for this many consecutive moves
+    public  int      drawAfter = 0;    // draw adjudication from this move on, 0 = off
+    public  int      drawScore = 0;    // when both scores stay within this many cp
+    public  int      drawCount = 0;    // for this many consecutive moves
     private Integer  nMoveDrawRule = 200;          // n-move rule - could be any number
     private String   gameRecord = null;        // san game record
     private int      gameno;
@@ -72,6 +77,11 @@ public class PlayGame implements Runnable
         long       ct = 0;       // for fischer time calculation
         long       mvstogo = 0;  // moves to go
         int        moveclock = nMoveDrawRule;  // count down to zero
+        Integer    score = null;  // score of the last move, white point of view
+        int        resignRun = 0;  // consecutive plies beyond resignScore
+        int        drawRun = 0;    // consecutive plies within drawScore
+        int        winner = 0;     // of an adjudicated game, 0 = white
+        String     adjudication = null;
 
         File killfile = new File("killme.now");
 
@@ -133,6 +143,7 @@ public class PlayGame implements Runnable
             int c = ctm & 1;
             if (c == 1) { z = pB; who = black; } else { who = white; z = pW; }
 
+            score = null;
             if (ctm < Math.min(MAX_BOOKMOVES, booklst.length)) {
                 mv = booklst[ctm];
                 st[c] = System.nanoTime();
@@ -257,6 +268,8 @@ public class PlayGame implements Runnable
                         et[c] = System.nanoTime();
                         de[c] = z.depthAchieved();
                         nd[c] = z.nodesAchieved();
+                        score = z.scoreAchieved();
+                        if (score != null && c == 1) score = -score;
                         tok = s.split(" ");
                         mv = tok[1];
                     }
@@ -353,6 +366,7 @@ public class PlayGame implements Runnable
                 // in config file this is "adjdicate = n"
                 if (ctm > (drawMoves-1) * 2) {
                     status = 1;
+                    adjudication = "move limit";
                 }
 
                 // n-move draw
@@ -362,6 +376,36 @@ public class PlayGame implements Runnable
                 }
             }
 
+            // score adjudication: both engines must agree, so the runs
+            // count plies and need twice as many as the configured moves
+            if (status == 0 && (resignScore > 0 || drawAfter > 0)) {
+                if (score == null) {
+                    resignRun = 0;
+                    drawRun = 0;
+                } else {
+                    int side = (score > 0) ? 0 : 1;
+                    if (resignScore > 0 && Math.abs(score) >= resignScore) {
+                        resignRun = (resignRun > 0 && side == winner) ? resignRun + 1 : 1;
+                        winner = side;
+                    } else {
+                        resignRun = 0;
+                    }
+                    if (drawAfter > 0 && mn >= drawAfter && Math.abs(score) <= drawScore) {
+                        drawRun = drawRun + 1;
+                    } else {
+                        drawRun = 0;
+                    }
+                }
+
+                if (resignScore > 0 && resignRun >= 2 * resignCount) {
+                    status = 3;
+                    adjudication = "resign";
+                } else if (drawAfter > 0 && drawRun >= 2 * drawCount) {
+                    status = 1;
+                    adjudication = "draw";
+                }
+            }
+
             if (killfile.exists() != true ) {
                 if (status != 0) {
                     et[c] = st[c] + 1;  // to avoid tripping the hung search detection
@@ -369,7 +413,18 @@ public class PlayGame implements Runnable
                     pB.snd("quit\n");
                     pW.cleanup();
                     pB.cleanup();
-                    if (status == 2) {
+                    if (adjudication != null) {
+                        head.append( "[Adjudication \"" + adjudication + "\"]\n" );
+                    }
+                    if (status == 3) {
+                        if (winner == 0) {
+                            san.append( " {Black resigns} 1-0" );
+                            head.append( "[Result \"1-0\"]\n" );
+                        } else {
+                            san.append( " {White resigns} 0-1" );
+                            head.append( "[Result \"0-1\"]\n" );
+                        }
+                    } else if (status == 2) {
                         if ((ctm & 1) == 1) {
                             san.append( " 0-1" );
                             head.append( "[Result \"0-1\"]\n" );
@@ -404,6 +459,7 @@ public class PlayGame implements Runnable
     private static void writePgn( String s, PlayGame g )
     {
         g.gameRecord = s;
+        Sprt.addGame( g.white.name, g.black.name, s, g.gameno );
 
         synchronized(pending) {
             while (pending.size() > 0) {
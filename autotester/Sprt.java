@@ -0,0 +1,187 @@
+/**
+ * Copyright (c) 2015 MIT License by 6.172 Staff
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ **/
+
+import  java.io.*;
+import  java.util.regex.Pattern;
+import  java.util.regex.Matcher;
+
+// Sequential probability ratio test between the first two players of
+// a configuration (candidate and baseline).  The log-likelihood ratio
+// is updated after each finished game with the trinomial (win, draw,
+// loss) normal approximation, and the match stops as soon as it leaves
+// the [lower, upper] band.
+
+public class Sprt {
+
+    static boolean enabled = false;
+    static double  elo0 = 0.0;        // H0: candidate is elo0 better
+    static double  elo1 = 5.0;        // H1: candidate is elo1 better
+    static double  alpha = 0.05;      // false positive rate
+    static double  beta = 0.05;       // false negative rate
+    static String  candidate;
+    static String  baseline;
+
+    private static int wins = 0;      // from the candidate point of view
+    private static int draws = 0;
+    private static int losses = 0;
+    private static double llr = 0.0;
+    private static int decision = 0;  // 1 = H1 accepted, -1 = H0 accepted
+    private static BufferedWriter trace = null;
+
+    private static final Pattern rp = Pattern.compile("\\[Result \"(.*)\"");
+
+    // parse "sprt = elo0 elo1 alpha beta"
+    public static void configure( String v )
+    {
+        String[] mi = v.split("\\s+");
+        elo0 = Double.parseDouble(mi[0]);
+        elo1 = Double.parseDouble(mi[1]);
+        if (mi.length > 3) {
+            alpha = Double.parseDouble(mi[2]);
+            beta = Double.parseDouble(mi[3]);
+        }
+        enabled = true;
+    }
+
+    public static void open( String tracefile, String cand, String base )
+    {
+        candidate = cand;
+        baseline = base;
+        try {
+            trace = new BufferedWriter(new FileWriter( tracefile ));
+            trace.write( String.format("# sprt %s vs %s  elo0 = %.2f  elo1 = %.2f  alpha = %.3f  beta = %.3f\n",
+                                       cand, base, elo0, elo1, alpha, beta) );
+            trace.write( String.format("# lower = %.4f  upper = %.4f\n", lower(), upper()) );
+            trace.write( "# game  wins  draws  losses  llr\n" );
+            trace.flush();
+        } catch (IOException e) {
+            System.out.println(e);
+        }
+    }
+
+    public static double lower()
+    {
+        return Math.log(beta / (1.0 - alpha));
+    }
+
+    public static double upper()
+    {
+        return Math.log((1.0 - beta) / alpha);
+    }
+
+    private static double score( double elo )
+    {
+        return 1.0 / (1.0 + Math.pow(10.0, -elo / 400.0));
+    }
+
+    private static void update()
+    {
+        double n = wins + draws + losses;
+        double s = (wins + 0.5 * draws) / n;
+        double var = (wins * (1.0 - s) * (1.0 - s) +
+                      draws * (0.5 - s) * (0.5 - s) +
+                      losses * s * s) / n;
+
+        // no information about the variance yet
+        if (var <= 0.0) {
+            llr = 0.0;
+            return;
+        }
+
+        double s0 = score(elo0);
+        double s1 = score(elo1);
+        llr = n * (s1 - s0) * (2.0 * s - s0 - s1) / (2.0 * var);
+
+        if (llr >= upper()) decision = 1;
+        if (llr <= lower()) decision = -1;
+    }
+
+    // record the result of a finished game, given its PGN record
+    public synchronized static void addGame( String white, String black, String record, int gameno )
+    {
+        if (!enabled || decision != 0) return;
+
+        Matcher rm = rp.matcher(record);
+        if (!rm.find()) return;
+        addResult( white, black, rm.group(1), gameno );
+    }
+
+    public synchronized static void addResult( String white, String black, String result, int gameno )
+    {
+        if (!enabled || decision != 0) return;
+
+        int r;
+        if (result.equals("1-0")) r = 1;
+        else if (result.equals("0-1")) r = -1;
+        else if (result.equals("1/2-1/2")) r = 0;
+        else return;
+
+        if (white.equals(candidate) && black.equals(baseline)) {
+            // r is already from the candidate point of view
+        } else if (white.equals(baseline) && black.equals(candidate)) {
+            r = -r;
+        } else {
+            return;
+        }
+
+        if (r > 0) wins++; else if (r < 0) losses++; else draws++;
+        update();
+
+        if (trace != null) {
+            try {
+                trace.write( String.format("%6d %5d %6d %7d  %.4f\n", gameno, wins, draws, losses, llr) );
+                if (decision != 0) {
+                    trace.write( "# " + verdict() + "\n" );
+                }
+                trace.flush();
+            } catch (IOException e) {
+                System.out.println(e);
+            }
+        }
+    }
+
+    public synchronized static boolean decided()
+    {
+        return enabled && decision != 0;
+    }
+
+    public synchronized static String verdict()
+    {
+        String s = String.format("SPRT %s vs %s: +%d =%d -%d  llr %.3f [%.3f, %.3f]",
+                                 candidate, baseline, wins, draws, losses, llr, lower(), upper());
+        if (decision > 0) return s + "  H1 accepted";
+        if (decision < 0) return s + "  H0 accepted";
+        return s + "  inconclusive";
+    }
+
+    public synchronized static void close()
+    {
+        if (trace == null) return;
+        try {
+            trace.close();
+        } catch (IOException e) {
+            System.out.println(e);
+        }
+        trace = null;
+    }
+
+}
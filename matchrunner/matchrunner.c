@@ -0,0 +1,1110 @@
+// Copyright (c) 2015 MIT License by 6.172 Staff
+
+// Native match runner for UCI engines.
+//
+// Reads the same configuration files as the Java autotester (lauto.jar)
+// and appends games to <test>.pgn in the same format, but keeps a pool of
+// long-lived engine processes: each concurrent game slot is a thread
+// pinned to its own cores, which starts an engine for a player the first
+// time it needs one and then reuses it with "ucinewgame" for every
+// following game.  Engine output is read from non-blocking pipes through
+// one epoll instance per slot, so nothing sleeps or polls between moves.
+//
+// Moves are refereed with the player's own move generator.
+
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fen.h"
+#include "move_gen.h"
+
+#define VERSION "matchrunner version 1.0"
+
+#define MAX_PLAYERS 512
+#define MAX_OPTIONS 64
+#define MAX_BOOK 100000
+#define MAX_GAME_PLY 8192       // adjudicate is capped at 4000 moves
+#define LINE_SIZE 16384         // longest engine output line we keep
+#define DEFAULT_GAME_ROUNDS 1000
+#define DEFAULT_DEPTH 4
+#define MAX_BOOKMOVES 10
+#define MIN_BOOKMOVES 2
+#define N_MOVE_DRAW_RULE 200
+#define HANDSHAKE_TIMEOUT 10000000000LL  // uci / isready, in ns
+#define MOVE_GRACE 5000000000LL          // over the remaining time, in ns
+#define PROGRESS_INTERVAL 10             // seconds
+
+// -----------------------------------------------------------------------------
+// Configuration
+// -----------------------------------------------------------------------------
+
+typedef struct {
+  int      id;
+  char     name[64];
+  char     fam[64];      // family designation
+  char     invoke[1024];
+  int      depth;
+  int      nodes;        // if not zero, then use nodes
+  int64_t  fis_main;     // in nanoseconds
+  int64_t  fis_inc;      // in nanoseconds
+  int64_t  tc_mvs[2];    // in moves
+  int64_t  tc_tme[2];    // in nanoseconds
+  char     *options[MAX_OPTIONS];
+  int      num_options;
+  int      count[MAX_PLAYERS];  // how many games against a given opponent
+  int      skip[MAX_PLAYERS];   // precomputed opening skip factors
+  int      ofst[MAX_PLAYERS];   // precomputed opening offsets
+} player_t;
+
+static player_t *players[MAX_PLAYERS];
+static int total_players = 0;
+static char title[256] = "Autotest";
+static char opening_book[1024] = "";
+static int cpus = 1;
+static int cores_per_game = 1;
+static int adjudicate = 400;
+static int resign[2] = { 0, 0 };     // score adjudication: cp, moves
+static int draw[3] = { 0, 0, 0 };    // draw adjudication: after move, cp, moves
+static int game_rounds = 0;
+static char pgnfile[1024];
+
+static char *book[MAX_BOOK];
+static int book_count = 0;
+
+// -----------------------------------------------------------------------------
+// Engines and game slots
+// -----------------------------------------------------------------------------
+
+typedef struct {
+  pid_t    pid;
+  int      in_fd;      // engine stdin
+  int      out_fd;     // engine stdout, non-blocking
+  bool     alive;
+  char     buf[LINE_SIZE];
+  int      len;        // bytes in buf
+  int      consumed;   // bytes of buf returned as the last line
+  int      depth;      // last " depth N" seen
+  int64_t  nodes;      // last " nodes N" seen
+  bool     has_score;  // whether " score cp N" was seen in this search
+  int      score;      // last best-line score, from the mover's view
+} engine_t;
+
+typedef struct {
+  int        id;
+  int        epfd;
+  cpu_set_t  cpus;
+  engine_t   *engines[MAX_PLAYERS];  // started on first use
+  pthread_t  thread;
+} slot_t;
+
+// -----------------------------------------------------------------------------
+// Scheduler and PGN writer state, guarded by sched_mutex
+// -----------------------------------------------------------------------------
+
+static pthread_mutex_t sched_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sched_cond = PTHREAD_COND_INITIALIZER;
+static int gn = 0;             // next game number
+static int first_gameno = 0;   // game number of the first game of this run
+static int started = 0;        // games started in this run
+static int finished = 0;       // games finished in this run
+static int slots_running = 0;
+static char **records;         // finished games, by gameno - first_gameno
+static int next_write = 0;     // next record to append to the PGN file
+static FILE *pgnwrite;
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// -----------------------------------------------------------------------------
+// Growable strings
+// -----------------------------------------------------------------------------
+
+typedef struct {
+  char  *s;
+  size_t len;
+  size_t cap;
+} strbuf_t;
+
+static void sb_printf(strbuf_t *sb, const char *fmt, ...) {
+  while (true) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(sb->s + sb->len, sb->cap - sb->len, fmt, ap);
+    va_end(ap);
+    if (sb->s != NULL && sb->len + n < sb->cap) {
+      sb->len += n;
+      return;
+    }
+    sb->cap = 2 * (sb->len + n + 64);
+    sb->s = realloc(sb->s, sb->cap);
+  }
+}
+
+static void sb_clear(strbuf_t *sb) {
+  sb->len = 0;
+  if (sb->s != NULL) {
+    sb->s[0] = '\0';
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Opening selection, identical to Harness.java (which hashes with
+// java.lang.String.hashCode)
+// -----------------------------------------------------------------------------
+
+static int32_t java_hash(const char *a, const char *sep, const char *b) {
+  uint32_t h = 0;
+  for (const char *s = a; *s; s++) h = 31 * h + (unsigned char) *s;
+  for (const char *s = sep; *s; s++) h = 31 * h + (unsigned char) *s;
+  for (const char *s = b; *s; s++) h = 31 * h + (unsigned char) *s;
+  return (int32_t) h;
+}
+
+static int lcd(int64_t x, int64_t y) {
+  int64_t max = x;
+  if (y < x) max = y;
+  for (int i = 2; i <= max; i++) {
+    if ((x % i) == (y % i)) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+static int set_skip(const char *w, const char *b) {
+  int64_t bc = book_count;
+
+  if (bc < 3) return 1;
+
+  int64_t sk = 0xffffffffLL & (int64_t) java_hash(w, "|", b);
+
+  while (true) {
+    sk = sk % book_count;
+    if (sk == 0) sk++;
+
+    int64_t m = bc % sk;
+    int64_t y = lcd(m, sk);
+
+    if (m != 0) {
+      if (y == 0) break;
+    }
+    sk++;
+  }
+  return (int) sk;
+}
+
+static int set_ofst(const char *w, const char *b) {
+  int64_t ofst = 0xffffffffLL & (int64_t) java_hash(b, "<->", w);
+  return (int) (ofst % book_count);
+}
+
+// find pairing with least number of games played; returns white << 16 | black
+static int get_next_match() {
+  int c = 999999999;
+  int p0 = 0;
+  int p1 = 0;
+
+  for (int a = 0; a < total_players - 1; a++) {
+    player_t *pl_a = players[a];
+    for (int b = a + 1; b < total_players; b++) {
+      player_t *pl_b = players[b];
+      if (strcmp(pl_a->fam, pl_b->fam) != 0) {
+        if (pl_a->count[b] < c) {
+          c = pl_a->count[b];
+          if (strcmp(pl_a->name, pl_b->name) > 0) {
+            p0 = a;
+            p1 = b;
+          } else {
+            p1 = a;
+            p0 = b;
+          }
+        }
+      }
+    }
+  }
+
+  if ((players[p0]->count[p1] & 1) == 1) {
+    return (p1 << 16) | p0;
+  } else {
+    return (p0 << 16) | p1;
+  }
+}
+
+// Returns false when no more games should be started
+static bool next_game(player_t **w, player_t **b, const char **opening,
+                     int *gameno) {
+  bool ok = false;
+  pthread_mutex_lock(&sched_mutex);
+  if (started < game_rounds && access("killme.now", F_OK) != 0) {
+    int pv = get_next_match();
+    *w = players[pv >> 16];
+    *b = players[pv & 0xffff];
+    int64_t opn_ix = ((*w)->count[(*b)->id] / 2) % book_count;
+    opn_ix = ((*w)->ofst[(*b)->id] + opn_ix * (*w)->skip[(*b)->id]) % book_count;
+    *opening = book[opn_ix];
+    (*w)->count[(*b)->id]++;
+    (*b)->count[(*w)->id]++;
+    *gameno = gn++;
+    started++;
+    ok = true;
+  }
+  pthread_mutex_unlock(&sched_mutex);
+  return ok;
+}
+
+// write PGN record(s) to the file in SEQUENCE; if the next game in line is
+// not complete, then stop
+static void write_pgn(int gameno, char *record) {
+  pthread_mutex_lock(&sched_mutex);
+  records[gameno - first_gameno] = record;
+  while (next_write < started && records[next_write] != NULL) {
+    fputs(records[next_write], pgnwrite);
+    free(records[next_write]);
+    records[next_write] = NULL;
+    next_write++;
+  }
+  fflush(pgnwrite);
+  finished++;
+  pthread_cond_broadcast(&sched_cond);
+  pthread_mutex_unlock(&sched_mutex);
+}
+
+// -----------------------------------------------------------------------------
+// Engine processes
+// -----------------------------------------------------------------------------
+
+static void engine_close(slot_t *slot, engine_t *e) {
+  if (!e->alive) return;
+  epoll_ctl(slot->epfd, EPOLL_CTL_DEL, e->out_fd, NULL);
+  close(e->in_fd);
+  close(e->out_fd);
+  kill(e->pid, SIGKILL);
+  waitpid(e->pid, NULL, 0);
+  e->alive = false;
+}
+
+static void engine_send(slot_t *slot, engine_t *e, const char *fmt, ...);
+
+// Ask the engine to quit, and kill it if it has not within a second
+static void engine_quit(slot_t *slot, engine_t *e) {
+  if (!e->alive) return;
+  engine_send(slot, e, "quit\n");
+  for (int i = 0; i < 100 && e->alive; i++) {
+    if (waitpid(e->pid, NULL, WNOHANG) == e->pid) {
+      epoll_ctl(slot->epfd, EPOLL_CTL_DEL, e->out_fd, NULL);
+      close(e->in_fd);
+      close(e->out_fd);
+      e->alive = false;
+      return;
+    }
+    struct timespec ts = { 0, 10000000 };
+    nanosleep(&ts, NULL);
+  }
+  engine_close(slot, e);
+}
+
+static void engine_send(slot_t *slot, engine_t *e, const char *fmt, ...) {
+  char s[LINE_SIZE + 64];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(s, sizeof(s), fmt, ap);
+  va_end(ap);
+  if (n >= (int) sizeof(s)) n = sizeof(s) - 1;
+
+  int done = 0;
+  while (e->alive && done < n) {
+    ssize_t r = write(e->in_fd, s + done, n - done);
+    if (r < 0) {
+      if (errno == EINTR) continue;
+      engine_close(slot, e);  // EPIPE: the engine has died
+      return;
+    }
+    done += r;
+  }
+}
+
+// Read whatever the ready engines of this slot have written, waiting at
+// most timeout_ms.  Output of engines other than the one we are waiting
+// for is buffered too, so the level-triggered epoll does not spin.
+static void slot_pump(slot_t *slot, int timeout_ms) {
+  struct epoll_event events[8];
+  int n = epoll_wait(slot->epfd, events, 8, timeout_ms);
+  for (int i = 0; i < n; i++) {
+    engine_t *e = events[i].data.ptr;
+    while (e->alive) {
+      if (e->len == LINE_SIZE - 1) {
+        if (e->consumed > 0) {
+          memmove(e->buf, e->buf + e->consumed, e->len - e->consumed);
+          e->len -= e->consumed;
+          e->consumed = 0;
+        } else {
+          break;  // a full line is waiting to be read
+        }
+      }
+      ssize_t r = read(e->out_fd, e->buf + e->len, LINE_SIZE - 1 - e->len);
+      if (r > 0) {
+        e->len += r;
+      } else if (r < 0 && errno == EINTR) {
+        continue;
+      } else if (r < 0 && errno == EAGAIN) {
+        break;
+      } else {
+        engine_close(slot, e);  // end of file
+      }
+    }
+  }
+}
+
+// Returns the next output line of e, or NULL if the engine has died or the
+// deadline (in ns, 0 for none) has passed.  The line stays valid until the
+// next call for the same engine.
+static char *engine_read_line(slot_t *slot, engine_t *e, uint64_t deadline) {
+  while (true) {
+    if (e->consumed > 0) {
+      memmove(e->buf, e->buf + e->consumed, e->len - e->consumed);
+      e->len -= e->consumed;
+      e->consumed = 0;
+    }
+
+    char *nl = memchr(e->buf, '\n', e->len);
+    if (nl != NULL || e->len == LINE_SIZE - 1) {
+      int n = (nl != NULL) ? nl - e->buf : e->len;
+      e->consumed = (nl != NULL) ? n + 1 : n;
+      e->buf[n] = '\0';
+      if (n > 0 && e->buf[n - 1] == '\r') e->buf[n - 1] = '\0';
+      return e->buf;
+    }
+
+    if (!e->alive) return NULL;
+
+    int timeout_ms = -1;
+    if (deadline != 0) {
+      uint64_t t = now_ns();
+      if (t >= deadline) return NULL;
+      timeout_ms = (deadline - t + 999999) / 1000000;
+    }
+    slot_pump(slot, timeout_ms);
+  }
+}
+
+// Wait for a line starting with w, tracking depth and nodes on the way
+static char *engine_wait_for(slot_t *slot, engine_t *e, const char *w,
+                             uint64_t deadline) {
+  size_t x = strlen(w);
+  char *s;
+  e->has_score = false;
+  while ((s = engine_read_line(slot, e, deadline)) != NULL) {
+    // with multipv, only the best line's score counts
+    char *sc = strstr(s, " score cp ");
+    char *mp = strstr(s, " multipv ");
+    if (sc != NULL && (mp == NULL || atoi(mp + 9) == 1)) {
+      e->score = atoi(sc + 10);
+      e->has_score = true;
+    }
+    char *d = strstr(s, " depth ");
+    if (d != NULL) e->depth = atoi(d + 7);
+    char *nd = strstr(s, " nodes ");
+    if (nd != NULL) e->nodes = strtoll(nd + 7, NULL, 10);
+    if (strncmp(s, w, x) == 0) return s;
+  }
+  return NULL;
+}
+
+static bool engine_start(slot_t *slot, engine_t *e, player_t *pl) {
+  int to_child[2];
+  int from_child[2];
+  if (pipe2(to_child, O_CLOEXEC) != 0) return false;
+  if (pipe2(from_child, O_CLOEXEC) != 0) {
+    close(to_child[0]);
+    close(to_child[1]);
+    return false;
+  }
+
+  // The slot thread is already pinned, and the child inherits its mask
+  pid_t pid = fork();
+  if (pid == 0) {
+    dup2(to_child[0], 0);
+    dup2(from_child[1], 1);
+    char nworkers[16];
+    snprintf(nworkers, sizeof(nworkers), "%d", cores_per_game);
+    setenv("CILK_NWORKERS", nworkers, 0);
+    char cmd[1100];
+    snprintf(cmd, sizeof(cmd), "exec %s", pl->invoke);
+    execl("/bin/sh", "sh", "-c", cmd, (char *) NULL);
+    _exit(127);
+  }
+  close(to_child[0]);
+  close(from_child[1]);
+  if (pid < 0) {
+    close(to_child[1]);
+    close(from_child[0]);
+    return false;
+  }
+
+  e->pid = pid;
+  e->in_fd = to_child[1];
+  e->out_fd = from_child[0];
+  e->alive = true;
+  e->len = 0;
+  e->consumed = 0;
+  fcntl(e->out_fd, F_SETFL, fcntl(e->out_fd, F_GETFL) | O_NONBLOCK);
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = e;
+  epoll_ctl(slot->epfd, EPOLL_CTL_ADD, e->out_fd, &ev);
+
+  engine_send(slot, e, "uci\n");
+  if (engine_wait_for(slot, e, "uciok", now_ns() + HANDSHAKE_TIMEOUT) == NULL) {
+    printf("Error running program %s\n", pl->name);
+    engine_close(slot, e);
+    return false;
+  }
+  for (int i = 0; i < pl->num_options; i++) {
+    engine_send(slot, e, "%s\n", pl->options[i]);
+  }
+  return true;
+}
+
+// Returns a live engine of player pl, reset for a new game, or NULL
+static engine_t *engine_for_game(slot_t *slot, player_t *pl) {
+  engine_t *e = slot->engines[pl->id];
+  if (e == NULL) {
+    e = calloc(1, sizeof(engine_t));
+    slot->engines[pl->id] = e;
+  }
+  if (!e->alive && !engine_start(slot, e, pl)) {
+    return NULL;
+  }
+  engine_send(slot, e, "ucinewgame\nisready\n");
+  if (engine_wait_for(slot, e, "readyok", now_ns() + HANDSHAKE_TIMEOUT) == NULL) {
+    engine_close(slot, e);
+    return NULL;
+  }
+  e->depth = 0;
+  e->nodes = 0;
+  return e;
+}
+
+// -----------------------------------------------------------------------------
+// Playing a game
+// -----------------------------------------------------------------------------
+
+// Fill in the go command for the side to move; returns the time left in ns
+// (or 0 for depth and node limits), negative on a time forfeit
+static int64_t go_command(player_t *who, int ctm, int64_t acc, char *s,
+                          size_t size) {
+  int64_t ct = 0;
+  if (who->tc_tme[0] != 0) {
+    int64_t mvstogo = who->tc_mvs[0] - ctm / 2;
+    ct = who->tc_tme[0];  // time allocated so far
+    while (mvstogo < 1) {
+      mvstogo += who->tc_mvs[1];
+      ct += who->tc_tme[1];
+    }
+    ct = ct - acc;  // how much time left until next time control?
+    snprintf(s, size, "go time %" PRId64 " movestogo %" PRId64 "\n",
+             ct / 1000000, mvstogo);
+    return ct < 1 ? -1 : ct;
+  } else if (who->nodes != 0) {
+    snprintf(s, size, "go nodes %d\n", who->nodes);
+  } else if (who->depth != 0) {
+    snprintf(s, size, "go depth %d\n", who->depth);
+  } else if (who->fis_main != 0) {
+    ct = who->fis_main + who->fis_inc * (ctm / 2) - acc;
+    snprintf(s, size, "go time %" PRId64 " inc %" PRId64 "\n",
+             ct / 1000000, who->fis_inc / 1000000);
+    return ct < 1 ? -1 : ct;
+  } else {
+    snprintf(s, size, "go depth %d\n", DEFAULT_DEPTH);
+  }
+  return 0;
+}
+
+static void play_game(slot_t *slot, player_t *white, player_t *black,
+                      const char *opening, int gameno, strbuf_t *lst,
+                      strbuf_t *san, uint64_t *keys) {
+  player_t *pl[2] = { white, black };
+  engine_t *z[2];
+  int64_t acc[2] = { 0, 0 };   // accumulated time for each player
+  int de[2] = { 0, 0 };        // depth achieved
+  int64_t nd[2] = { 0, 0 };    // nodes
+  const char *result = NULL;
+  position_t cur, next;
+  char s[256];
+
+  strbuf_t head = { NULL, 0, 0 };
+  char date[128];
+  time_t t = time(NULL);
+  struct tm tm;
+  localtime_r(&t, &tm);
+  strftime(date, sizeof(date), "%a %Y.%m.%d at %I:%M:%S %p %Z", &tm);
+  sb_printf(&head, "[Event \"%s\"]\n", title);
+  sb_printf(&head, "[Site \"Local\"]\n");
+  sb_printf(&head, "[Date \"%s\"]\n", date);
+  sb_printf(&head, "[Round \"%d\"]\n", gameno);
+  sb_printf(&head, "[White \"%s\"]\n", white->name);
+  sb_printf(&head, "[Black \"%s\"]\n", black->name);
+
+  sb_clear(lst);
+  sb_clear(san);
+  sb_printf(lst, "moves");
+
+  char opn[4096];
+  snprintf(opn, sizeof(opn), "%s", opening);
+  char *booklst[MAX_BOOKMOVES];
+  int book_len = 0;
+  char *saveptr;
+  for (char *tok = strtok_r(opn, " \t\r\n", &saveptr);
+       tok != NULL && book_len < MAX_BOOKMOVES;
+       tok = strtok_r(NULL, " \t\r\n", &saveptr)) {
+    booklst[book_len++] = tok;
+  }
+  if (book_len < MIN_BOOKMOVES) {
+    printf("Too short opening line with %d moves --ok\n", book_len);
+  }
+
+  z[0] = engine_for_game(slot, white);
+  z[1] = engine_for_game(slot, black);
+
+  fen_to_pos(&cur, "");
+  keys[0] = cur.key;
+
+  int mn = 0;
+  int moveclock = N_MOVE_DRAW_RULE;  // count down to zero
+  int resign_run = 0;   // consecutive plies beyond resign[0]
+  int draw_run = 0;     // consecutive plies within draw[1]
+  int winner = 0;       // of an adjudicated game, 0 = white
+  const char *adjudication = NULL;
+  for (int ctm = 0; result == NULL; ctm++) {
+    int c = ctm & 1;
+    const char *irr = NULL;  // irregular move or game loss
+    const char *mv;
+    char bestmove[MAX_CHARS_IN_MOVE + 1];
+    int64_t elapsed = -1;  // -1 means book move
+    bool has_score = false;
+    int score = 0;         // white point of view
+
+    if (ctm < book_len) {
+      mv = booklst[ctm];
+    } else {
+      int64_t ct = go_command(pl[c], ctm, acc[c], s, sizeof(s));
+      if (ct < 0) {
+        irr = c ? "{White wins due to time forfeit}" : "{Black wins due to time forfeit}";
+        mv = "";
+      } else {
+        char *line = NULL;
+        uint64_t st = now_ns();
+        if (z[c] != NULL) {
+          engine_send(slot, z[c], "position startpos %s\n", lst->s);
+          engine_send(slot, z[c], "%s", s);
+          st = now_ns();
+          line = engine_wait_for(slot, z[c], "bestmove",
+                                 ct > 0 ? st + ct + MOVE_GRACE : 0);
+        }
+        uint64_t et = now_ns();
+
+        if (line == NULL && z[c] != NULL && z[c]->alive) {
+          // hung past its time: forfeit, and restart it for the next game
+          engine_close(slot, z[c]);
+          irr = c ? "{White wins due to time forfeit}" : "{Black wins due to time forfeit}";
+          mv = "";
+        } else if (line == NULL) {
+          printf("Program %s has died!\n", pl[c]->invoke);
+          sb_printf(san, " %s", c ? "{White wins due to program crash}" :
+                    "{Black wins due to program crash}");
+          result = c ? "1-0" : "0-1";
+          break;
+        } else {
+          elapsed = et - st;
+          de[c] = z[c]->depth;
+          nd[c] = z[c]->nodes;
+          has_score = z[c]->has_score;
+          score = c ? -z[c]->score : z[c]->score;
+          bestmove[0] = '\0';
+          sscanf(line, "bestmove %16s", bestmove);
+          mv = bestmove;
+        }
+      }
+    }
+
+    if (irr == NULL) {
+      sb_printf(lst, " %s", mv);
+    }
+
+    if (c == 0) {
+      mn = mn + 1;
+      if (mn != 1 && ((mn - 1) % 5) == 0) {
+        sb_printf(san, "\n");
+      } else if (mn != 1) {
+        sb_printf(san, " ");
+      }
+      sb_printf(san, "%d.", mn);
+    }
+
+    if (irr != NULL) {
+      printf("Time forfeit in game %d by player \"%s\"\n", gameno, pl[c]->name);
+      sb_printf(san, " %s", irr);
+      result = c ? "1-0" : "0-1";
+      break;
+    }
+
+    // referee the move
+    move_t m = str_to_move(&cur, mv);
+    victims_t victims = ILLEGAL();
+    if (m != 0) {
+      victims = make_move(&cur, &next, m);
+    }
+    if (m == 0 || is_KO(victims) ||
+        (ctm >= 1 && next.key == keys[ctm - 1])) {
+      printf("%s\n Illegal move in game %d\n", lst->s, gameno);
+      sb_printf(san, " {Illegal move |%s| attempted.} ", mv);
+      result = c ? "1-0" : "0-1";
+      break;
+    }
+    cur = next;
+    keys[ctm + 1] = cur.key;
+
+    if (zero_victims(victims)) {
+      moveclock = moveclock - 1;
+    } else {
+      moveclock = N_MOVE_DRAW_RULE;
+    }
+
+    sb_printf(san, " %s", mv);
+    if (elapsed >= 0) {
+      sb_printf(san, " {%" PRId64 " %d %" PRId64 "}", elapsed, de[c], nd[c]);
+      acc[c] += elapsed;
+    } else {
+      sb_printf(san, " {0 %d %" PRId64 "}", de[c], nd[c]);
+    }
+
+    if (ptype_of(victims.zapped) == KING) {
+      result = (color_of(victims.zapped) == WHITE) ? "0-1" : "1-0";
+      break;
+    }
+
+    // draw by repetition: the same position for the third time
+    int reps = 0;
+    for (int k = ctm + 1 - 4; k >= 0; k -= 2) {
+      if (keys[k] == keys[ctm + 1] && ++reps == 2) break;
+    }
+    if (reps == 2) {
+      result = "1/2-1/2";
+    } else if (ctm > (adjudicate - 1) * 2) {
+      result = "1/2-1/2";
+      adjudication = "move limit";
+    } else if (moveclock <= 0) {
+      printf("%d move draw detected\n", N_MOVE_DRAW_RULE);
+      result = "1/2-1/2";
+    }
+
+    // score adjudication: both engines must agree, so the runs count plies
+    // and need twice as many as the configured moves
+    if (result == NULL && (resign[0] > 0 || draw[0] > 0)) {
+      if (!has_score) {
+        resign_run = 0;
+        draw_run = 0;
+      } else {
+        int side = (score > 0) ? 0 : 1;
+        if (resign[0] > 0 && abs(score) >= resign[0]) {
+          resign_run = (resign_run > 0 && side == winner) ? resign_run + 1 : 1;
+          winner = side;
+        } else {
+          resign_run = 0;
+        }
+        if (draw[0] > 0 && mn >= draw[0] && abs(score) <= draw[1]) {
+          draw_run++;
+        } else {
+          draw_run = 0;
+        }
+      }
+
+      if (resign[0] > 0 && resign_run >= 2 * resign[1]) {
+        sb_printf(san, winner ? " {White resigns}" : " {Black resigns}");
+        result = winner ? "0-1" : "1-0";
+        adjudication = "resign";
+      } else if (draw[0] > 0 && draw_run >= 2 * draw[2]) {
+        result = "1/2-1/2";
+        adjudication = "draw";
+      }
+    }
+  }
+
+  sb_printf(san, " %s", result);
+  if (adjudication != NULL) {
+    sb_printf(&head, "[Adjudication \"%s\"]\n", adjudication);
+  }
+  sb_printf(&head, "[Result \"%s\"]\n", result);
+  sb_printf(&head, "\n%s\n\n", san->s);
+  write_pgn(gameno, head.s);
+}
+
+static void *slot_main(void *arg) {
+  slot_t *slot = arg;
+  strbuf_t lst = { NULL, 0, 0 };
+  strbuf_t san = { NULL, 0, 0 };
+  uint64_t *keys = malloc(sizeof(uint64_t) * (MAX_GAME_PLY + 1));
+
+  if (CPU_COUNT(&slot->cpus) > 0) {
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &slot->cpus);
+  }
+
+  player_t *w;
+  player_t *b;
+  const char *opening;
+  int gameno;
+  while (next_game(&w, &b, &opening, &gameno)) {
+    play_game(slot, w, b, opening, gameno, &lst, &san, keys);
+  }
+
+  for (int i = 0; i < total_players; i++) {
+    engine_t *e = slot->engines[i];
+    if (e != NULL) {
+      engine_quit(slot, e);
+      free(e);
+    }
+  }
+  free(keys);
+  free(lst.s);
+  free(san.s);
+  close(slot->epfd);
+
+  pthread_mutex_lock(&sched_mutex);
+  slots_running--;
+  pthread_cond_broadcast(&sched_cond);
+  pthread_mutex_unlock(&sched_mutex);
+  return NULL;
+}
+
+// -----------------------------------------------------------------------------
+// Configuration and PGN parsing
+// -----------------------------------------------------------------------------
+
+static char *trim(char *s) {
+  while (isspace((unsigned char) *s)) s++;
+  char *e = s + strlen(s);
+  while (e > s && isspace((unsigned char) e[-1])) *--e = '\0';
+  return s;
+}
+
+static player_t *find_player(const char *name) {
+  for (int i = 0; i < total_players; i++) {
+    if (strcmp(players[i]->name, name) == 0) return players[i];
+  }
+  return NULL;
+}
+
+static void read_config(const char *cfg) {
+  FILE *f = fopen(cfg, "r");
+  if (f == NULL) {
+    fprintf(stderr, "Cannot open configuration file %s\n", cfg);
+    exit(1);
+  }
+
+  char s[4096];
+  player_t *cur = NULL;
+  while (fgets(s, sizeof(s), f) != NULL) {
+    char *line = trim(s);
+    if (strlen(line) < 3) continue;
+    if (line[0] == '#') continue;
+
+    char *eq = strchr(line, '=');
+    if (eq == NULL || strchr(eq + 1, '=') != NULL) {
+      printf("Illegal line in configuration file:\n%s\n", line);
+      exit(1);
+    }
+    *eq = '\0';
+    char *k = trim(line);
+    char *v = trim(eq + 1);
+
+    if (strcmp(k, "player") != 0 && cur == NULL &&
+        (strcmp(k, "family") == 0 || strcmp(k, "invoke") == 0 ||
+         strcmp(k, "depth") == 0 || strcmp(k, "nodes") == 0 ||
+         strcmp(k, "fis") == 0 || strcmp(k, "tc") == 0)) {
+      printf("Configuration file error. \"%s\" before any player\n", k);
+      exit(1);
+    }
+
+    if (strcmp(k, "title") == 0) {
+      snprintf(title, sizeof(title), "%s", v);
+    } else if (strcmp(k, "player") == 0) {
+      if (find_player(v) != NULL) {
+        fprintf(stderr, "Configuration file error. Player \"%s\" defined twice\n", v);
+        exit(1);
+      }
+      if (total_players == MAX_PLAYERS) {
+        fprintf(stderr, "Too many players\n");
+        exit(1);
+      }
+      cur = calloc(1, sizeof(player_t));
+      cur->id = total_players;
+      snprintf(cur->name, sizeof(cur->name), "%s", v);
+      snprintf(cur->fam, sizeof(cur->fam), "%s", v);  // by default family is same as player
+      players[total_players++] = cur;
+    } else if (strcmp(k, "cpus") == 0) {
+      cpus = atoi(v);
+    } else if (strcmp(k, "cores_per_game") == 0) {
+      cores_per_game = atoi(v);
+      if (cores_per_game < 1) cores_per_game = 1;
+    } else if (strcmp(k, "adjudicate") == 0) {
+      adjudicate = atoi(v);
+      if (adjudicate > 4000) adjudicate = 4000;
+      if (adjudicate < 2) adjudicate = 2;
+    } else if (strcmp(k, "resign") == 0) {
+      sscanf(v, "%d %d", &resign[0], &resign[1]);
+      resign[0] = abs(resign[0]);
+    } else if (strcmp(k, "draw") == 0) {
+      sscanf(v, "%d %d %d", &draw[0], &draw[1], &draw[2]);
+      draw[1] = abs(draw[1]);
+    } else if (strcmp(k, "book") == 0) {
+      snprintf(opening_book, sizeof(opening_book), "%s", v);
+    } else if (strcmp(k, "game_rounds") == 0) {
+      game_rounds = atoi(v);
+    } else if (strcmp(k, "desc") == 0) {
+      // not used
+    } else if (strcmp(k, "sprt") == 0) {
+      printf("sprt is only supported by lauto.jar, ignored\n");
+    } else if (strcmp(k, "family") == 0) {
+      snprintf(cur->fam, sizeof(cur->fam), "%s", v);
+    } else if (strcmp(k, "invoke") == 0) {
+      snprintf(cur->invoke, sizeof(cur->invoke), "%s", v);
+    } else if (strcmp(k, "depth") == 0) {
+      cur->depth = atoi(v);
+    } else if (strcmp(k, "nodes") == 0) {
+      char digits[64];
+      int n = 0;
+      for (char *p = v; *p && n < 63; p++) {
+        if (*p != '.' && *p != ',') digits[n++] = *p;
+      }
+      digits[n] = '\0';
+      cur->nodes = atoi(digits);
+    } else if (strcmp(k, "fis") == 0) {
+      double main_sec = 0, inc_sec = 0;
+      sscanf(v, "%lf %lf", &main_sec, &inc_sec);
+      cur->fis_main = (int64_t) (1000000000.0 * main_sec);
+      cur->fis_inc = (int64_t) (1000000000.0 * inc_sec);
+    } else if (strcmp(k, "tc") == 0) {
+      double t0 = 0, t1 = 0;
+      long long m0 = 0, m1 = 0;
+      int n = sscanf(v, "%lld %lf %lld %lf", &m0, &t0, &m1, &t1);
+      cur->tc_mvs[0] = m0;
+      cur->tc_tme[0] = (int64_t) (1000000000.0 * t0);
+      if (n > 3) {
+        cur->tc_mvs[1] = m1;
+        cur->tc_tme[1] = (int64_t) (1000000000.0 * t1);
+      } else {
+        cur->tc_mvs[1] = cur->tc_mvs[0];
+        cur->tc_tme[1] = cur->tc_tme[0];
+      }
+    } else {
+      // anything that goes this far becomes a setoption
+      if (cur == NULL || cur->num_options == MAX_OPTIONS) {
+        printf("Illegal option found in configuration file: %s\n", k);
+        exit(1);
+      }
+      char opt[4096];
+      snprintf(opt, sizeof(opt), "setoption name %s value %s", k, v);
+      cur->options[cur->num_options++] = strdup(opt);
+    }
+  }
+  fclose(f);
+}
+
+// count the games already in the PGN file, as Harness.parsePgn does
+static void parse_pgn() {
+  FILE *f = fopen(pgnfile, "r");
+  if (f == NULL) {
+    printf("PGN file %s not found.  Keep going.\n\n", pgnfile);
+    return;
+  }
+
+  char s[4096];
+  char w[64] = "";
+  char b[64] = "";
+  while (fgets(s, sizeof(s), f) != NULL) {
+    if (sscanf(s, "[White \"%63[^\"]\"", w) == 1) continue;
+    if (sscanf(s, "[Black \"%63[^\"]\"", b) == 1) continue;
+    if (strncmp(s, "[Result \"", 9) == 0) {
+      player_t *pw = find_player(w);
+      player_t *pb = find_player(b);
+      if (pw != NULL && pb != NULL) {
+        pw->count[pb->id] += 1;  // how many games against a given player
+        pb->count[pw->id] += 1;  // ditto
+        gn++;
+      }
+    }
+  }
+  fclose(f);
+}
+
+static void read_book() {
+  if (opening_book[0] == '\0') {
+    printf("No opening book specified.");
+    exit(0);
+  }
+  printf("Use opening book specified: %s\n", opening_book);
+  FILE *f = fopen(opening_book, "r");
+  if (f == NULL) {
+    printf("Error: cannot open %s\n", opening_book);
+    exit(0);
+  }
+  char s[4096];
+  while (book_count < MAX_BOOK && fgets(s, sizeof(s), f) != NULL) {
+    s[strcspn(s, "\r\n")] = '\0';
+    book[book_count++] = strdup(s);
+  }
+  fclose(f);
+  if (book_count == 0) {
+    printf("Error: empty opening book %s\n", opening_book);
+    exit(0);
+  }
+}
+
+// Give slot i its own cores_per_game cores out of the ones we may run on
+static void assign_cpus(slot_t *slots) {
+  cpu_set_t allowed;
+  int avail[CPU_SETSIZE];
+  int navail = 0;
+
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+  for (int c = 0; c < CPU_SETSIZE; c++) {
+    if (CPU_ISSET(c, &allowed)) avail[navail++] = c;
+  }
+  if (navail == 0) return;
+
+  for (int i = 0; i < cpus; i++) {
+    CPU_ZERO(&slots[i].cpus);
+    for (int j = 0; j < cores_per_game; j++) {
+      CPU_SET(avail[(i * cores_per_game + j) % navail], &slots[i].cpus);
+    }
+  }
+  if (cpus * cores_per_game > navail) {
+    printf("Warning: %d games x %d cores oversubscribe %d cpus\n",
+           cpus, cores_per_game, navail);
+  }
+}
+
+static void print_progress(uint64_t start_time, int games) {
+  double sec = (now_ns() - start_time) / 1000000000.0;
+  double gpm = 60.0 * finished / sec;
+  printf("%10.1f sec  %14.3f gpm  %8d games\n", sec, gpm, games);
+  fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+  printf("%s\n", VERSION);
+
+  if (argc < 2 || strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+    printf("Usage:\n");
+    printf("%s <test>[.txt]\n", argc > 0 ? argv[0] : "matchrunner");
+    printf("\tRun the games of configuration file <test>.txt\n");
+    printf("\tResults are appended to <test>.pgn\n");
+    exit(argc < 2 ? 1 : 0);
+  }
+
+  // configuration files always end with "txt" extension
+  char base[1024];
+  snprintf(base, sizeof(base), "%s", argv[1]);
+  size_t bl = strlen(base);
+  if (bl > 4 && strcmp(base + bl - 4, ".txt") == 0) base[bl - 4] = '\0';
+  char cfg[1100];
+  snprintf(cfg, sizeof(cfg), "%s.txt", base);
+  snprintf(pgnfile, sizeof(pgnfile), "%s.pgn", base);
+
+  unlink("killme.now");
+  signal(SIGPIPE, SIG_IGN);
+  init_zob();
+
+  read_config(cfg);
+  if (total_players < 2) {
+    printf("At least 2 players are needed.\n");
+    exit(1);
+  }
+  for (int i = 0; i < total_players; i++) {
+    if (players[i]->invoke[0] == '\0') {
+      printf("Player %s has no invoke line.\n", players[i]->name);
+      exit(1);
+    }
+  }
+  if (cpus < 1) cpus = 1;
+  if (game_rounds == 0) game_rounds = DEFAULT_GAME_ROUNDS;
+
+  parse_pgn();
+  read_book();
+
+  // precompute the skip and offset factors
+  for (int wid = 0; wid < total_players; wid++) {
+    for (int bid = 0; bid < total_players; bid++) {
+      if (wid == bid) continue;
+      player_t *whp = players[wid];
+      if (strcmp(whp->name, players[bid]->name) > 0) {
+        whp->skip[bid] = set_skip(players[bid]->name, whp->name);
+        whp->ofst[bid] = set_ofst(players[bid]->name, whp->name);
+      } else {
+        whp->skip[bid] = set_skip(whp->name, players[bid]->name);
+        whp->ofst[bid] = set_ofst(whp->name, players[bid]->name);
+      }
+    }
+  }
+
+  pgnwrite = fopen(pgnfile, "a");
+  if (pgnwrite == NULL) {
+    fprintf(stderr, "Error: cannot open %s\n", pgnfile);
+    exit(0);
+  }
+  first_gameno = gn;
+  records = calloc(game_rounds, sizeof(char *));
+
+  slot_t *slots = calloc(cpus, sizeof(slot_t));
+  assign_cpus(slots);
+
+  uint64_t start_time = now_ns();
+  slots_running = cpus;
+  for (int i = 0; i < cpus; i++) {
+    slots[i].id = i;
+    slots[i].epfd = epoll_create1(EPOLL_CLOEXEC);
+    pthread_create(&slots[i].thread, NULL, slot_main, &slots[i]);
+  }
+
+  pthread_mutex_lock(&sched_mutex);
+  while (slots_running > 0) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += PROGRESS_INTERVAL;
+    if (pthread_cond_timedwait(&sched_cond, &sched_mutex, &ts) == ETIMEDOUT) {
+      print_progress(start_time, gn);
+    }
+  }
+  pthread_mutex_unlock(&sched_mutex);
+
+  for (int i = 0; i < cpus; i++) {
+    pthread_join(slots[i].thread, NULL);
+  }
+  fclose(pgnwrite);
+
+  print_progress(start_time, gn);
+  printf("Finished ...\n");
+  return 0;
+}
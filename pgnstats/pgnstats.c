@@ -1,161 +1,533 @@
 // Copyright (c) 2015 MIT License by 6.172 Staff
 
+// pgnstats: time, node and depth statistics of the players in a PGN file
+// written by the autotester, whose move comments are {time_ns depth nodes}.
+//
+// The file is memory-mapped and split at game boundaries into chunks that
+// worker threads scan in parallel, each into its own table of players;
+// the tables are merged at the end.
+//
+// Usage: pgnstats [-t threads] [-b budget_sec] [-m] file.pgn [reference]
+
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <math.h>
 #include <unistd.h>
 #include <inttypes.h>
-// #include <windows.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define LAST_MOVE_NUMBER 80
+#define FIRST_COUNTED_MOVE 14  // summary table: skip the opening
+#define COUNT_DELAY 16         // summary table: and the last 8 moves of a game
+#define MAX_DEPTH 64
+#define TIME_BINS 160          // 4 per octave of nanoseconds, up to 2^40 ns
+#define NPS_BINS 1000          // 100 per decade of nodes per second
+#define MAX_NAME 64
+#define MAX_GAME_ENTRIES 4096
+#define CHUNKS_PER_THREAD 4
+
+#define Xisdigit(x) ((x) >= 48 && (x) <= 57)
+
+// Distributions of the searched moves at one move number
+typedef struct {
+  uint32_t  moves;
+  uint32_t  overtime;
+  int       min_depth;
+  int       max_depth;
+  int64_t   max_time;
+  double    time;               // sums
+  double    depth;
+  double    nodes;
+  uint32_t  time_bins[TIME_BINS];
+  uint32_t  depth_bins[MAX_DEPTH];
+} move_stats_t;
 
 typedef struct {
-  char name[64];
-  int  games;
-  int64_t  tt;
-  double  ts;       // time in seconds PER MOVE
-  double  nm;       // nodes in millions
-  int  depth;       // depth achieved
-  int64_t moves;  // total moves
-  int64_t nodes;  // total nodes
+  char      name[MAX_NAME];
+  int       games;
+  int64_t   tt;
+  double    ts;       // time in seconds PER MOVE
+  double    nm;       // nodes in millions
+  int       depth;    // depth achieved
+  int64_t   moves;    // total moves
+  int64_t   nodes;    // total nodes
+
+  // all searched moves, not only the ones of the summary table
+  int64_t   searched;
+  int64_t   overtime;
+  int64_t   max_time;
+  uint32_t  depth_bins[MAX_DEPTH];
+  uint32_t  nps_bins[NPS_BINS];
+  move_stats_t  *per_move;  // [LAST_MOVE_NUMBER + 1], the last one for later moves
 } player_t;
 
-player_t  players[1024];
-int       pc = 0;
+// Open addressing hash map from names to players
+typedef struct {
+  player_t  *players;
+  int       pc;
+  int       cap;       // of players
+  int       *slots;    // index + 1, 0 if empty
+  int       mask;
+} table_t;
+
+// One move comment of the game being scanned
+typedef struct {
+  int       mn;
+  int       ctm;
+  int64_t   t;
+  int       d;
+  int64_t   n;
+} entry_t;
 
-#define Xisdigit(x) ((x) >= 48 && (x) <= 57)
+typedef struct {
+  const char  *begin;
+  const char  *end;
+} chunk_t;
+
+static int64_t budget = 0;  // overtime threshold in ns, 0 if not given
+static chunk_t *chunks;
+static int num_chunks;
+static int next_chunk = 0;
+
+static uint32_t hash_name(const char *s, size_t n) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < n; i++) {
+    h = (h ^ (unsigned char) s[i]) * 16777619u;
+  }
+  return h;
+}
 
+static void table_init(table_t *t) {
+  t->pc = 0;
+  t->cap = 64;
+  t->players = malloc(sizeof(player_t) * t->cap);
+  t->mask = 127;
+  t->slots = calloc(t->mask + 1, sizeof(int));
+}
 
-int ParseString(char *ps, char *fld[]) {
-  int   field_count = 0;
-  char  *tok;
-  int   i;
-  char  *saveptr;
+static void table_insert_slot(table_t *t, int i) {
+  const char *name = t->players[i].name;
+  uint32_t h = hash_name(name, strlen(name)) & t->mask;
+  while (t->slots[h] != 0) h = (h + 1) & t->mask;
+  t->slots[h] = i + 1;
+}
 
-  field_count = 0;
-  for (i = 0, tok = strtok_r(ps, " \t\n\r", &saveptr);
-       tok != NULL;
-       tok = strtok_r(NULL, " \t\n\r", &saveptr), i++) {
-     fld[i] = tok;
-     field_count++;
+// Returns the player called name (n bytes), creating it if needed
+static player_t *table_get(table_t *t, const char *name, size_t n) {
+  if (n >= MAX_NAME) n = MAX_NAME - 1;
+  uint32_t h = hash_name(name, n) & t->mask;
+  while (t->slots[h] != 0) {
+    player_t *p = &t->players[t->slots[h] - 1];
+    if (strncmp(p->name, name, n) == 0 && p->name[n] == '\0') return p;
+    h = (h + 1) & t->mask;
   }
 
-  fld[ field_count ] = NULL;
-  return field_count;
+  if (t->pc == t->cap) {
+    t->cap *= 2;
+    t->players = realloc(t->players, sizeof(player_t) * t->cap);
+  }
+  player_t *p = &t->players[t->pc];
+  memset(p, 0, sizeof(*p));
+  memcpy(p->name, name, n);
+  p->name[n] = '\0';
+  t->pc++;
+
+  if (2 * t->pc > t->mask) {  // keep the load factor under 1/2
+    free(t->slots);
+    t->mask = 2 * t->mask + 1;
+    t->slots = calloc(t->mask + 1, sizeof(int));
+    for (int i = 0; i < t->pc; i++) table_insert_slot(t, i);
+  } else {
+    t->slots[h] = t->pc;
+  }
+  return p;
 }
 
+static int time_bin(int64_t t) {
+  if (t < 1) return 0;
+  int b = (int) (4.0 * log2((double) t));
+  return b >= TIME_BINS ? TIME_BINS - 1 : b;
+}
 
-int main(int argc, char *argv[]) {
-  int             i;
-  int             j;
-  int             ctm = 0;
-  FILE            *f;
-  char            s[4096];
-  char            *x;
-  int             tc;
-  char            *tok[1024];
-  player_t        *who[2];
-  char            ref[64];   // reference player if not specified
-  int             rix = 0;   // reference index
-  int             mn = 0;    // move number of game being parsed
-  int64_t   tq[32];
-  int64_t   nq[32];
-  int             dq[32];
-  int             q = 0;
-  char            *saveptr;
+static double time_of_bin(int b) {
+  return exp2((b + 0.5) / 4.0);
+}
 
-  printf("\n");
-  f = fopen(argv[1], "r");
-
-  snprintf(ref, sizeof(ref), "");
-  if (argc > 2) {
-    snprintf(ref, sizeof(ref), "%s", argv[2]);
-  }
-
-  int ln = 0;
-  while (fgets(s, 4096, f) != NULL) {
-    ln++;
-    if (strncmp(s+1, "White ", 6) == 0) {
-      x = strtok_r(s+1, "\"", &saveptr);
-      x = strtok_r(NULL, "\"", &saveptr);
-      for (i = 0; i < pc; i++) if (strcmp(players[i].name, x) == 0) break;
-
-      if (i == pc) {  // player not found,  create a new entry
-        snprintf(players[pc].name, sizeof(players[pc].name), "%s", x);
-        players[pc].tt = 0ull;
-        players[pc].games = 0;
-        players[pc].depth = 0;
-        players[pc].moves = 0;
-        pc++;
-      }
-      who[0] = players + i;
-      who[0]->games++;
+static int nps_bin(double nps) {
+  if (nps < 1.0) return 0;
+  int b = (int) (100.0 * log10(nps));
+  return b >= NPS_BINS ? NPS_BINS - 1 : b;
+}
+
+static double nps_of_bin(int b) {
+  return pow(10.0, (b + 0.5) / 100.0);
+}
+
+// record a searched move in the per-move distributions
+static void add_searched(player_t *p, const entry_t *e) {
+  if (p->per_move == NULL) {
+    p->per_move = calloc(LAST_MOVE_NUMBER + 1, sizeof(move_stats_t));
+  }
+  int mn = e->mn < LAST_MOVE_NUMBER ? e->mn : LAST_MOVE_NUMBER;
+  int d = e->d < 0 ? 0 : (e->d >= MAX_DEPTH ? MAX_DEPTH - 1 : e->d);
+  move_stats_t *m = &p->per_move[mn];
+
+  if (m->moves == 0 || e->d < m->min_depth) m->min_depth = e->d;
+  if (m->moves == 0 || e->d > m->max_depth) m->max_depth = e->d;
+  if (e->t > m->max_time) m->max_time = e->t;
+  m->moves++;
+  m->time += e->t;
+  m->depth += e->d;
+  m->nodes += e->n;
+  m->time_bins[time_bin(e->t)]++;
+  m->depth_bins[d]++;
+
+  p->searched++;
+  p->depth_bins[d]++;
+  if (e->t > p->max_time) p->max_time = e->t;
+  if (budget > 0 && e->t > budget) {
+    m->overtime++;
+    p->overtime++;
+  }
+  if (e->t > 0) {
+    p->nps_bins[nps_bin(e->n * 1e9 / e->t)]++;
+  }
+}
+
+// Account the move comments of one game.  Every searched move goes to the
+// distributions.  The summary table counts, at each comment from move
+// FIRST_COUNTED_MOVE up to LAST_MOVE_NUMBER, the comment COUNT_DELAY plies
+// earlier, which leaves out the opening and the end of the game.
+static void end_game(player_t *who[2], entry_t *e, int ne) {
+  for (int k = 0; k < ne; k++) {
+    player_t *p = who[e[k].ctm];
+    if (p == NULL) continue;
+
+    if (e[k].t != 0 || e[k].n != 0) {  // book moves are {0 0 0}
+      add_searched(p, &e[k]);
+    }
+
+    if (e[k].mn < FIRST_COUNTED_MOVE || e[k].mn >= LAST_MOVE_NUMBER ||
+        k < COUNT_DELAY) {
       continue;
     }
+    const entry_t *c = &e[k - COUNT_DELAY];
+    p->tt += c->t;
+    p->depth += c->d;
+    p->nodes += c->n;
+    p->moves++;
+  }
+}
+
+// Returns the text of a tag line [Tag "text"], and its length in n
+static const char *tag_value(const char *s, const char *end, size_t *n) {
+  const char *q = memchr(s, '"', end - s);
+  if (q == NULL) return NULL;
+  q++;
+  const char *r = memchr(q, '"', end - q);
+  if (r == NULL) r = end;
+  *n = r - q;
+  return q;
+}
 
-    if (strncmp(s+1, "Black ", 6) == 0) {
-      x = strtok_r(s+1, "\"", &saveptr);
-      x = strtok_r(NULL, "\"", &saveptr);
-      for (i = 0; i < pc; i++) if (strcmp(players[i].name, x) == 0) break;
-
-      if (i == pc) {  // player not found, create a new entry
-        snprintf(players[pc].name, sizeof(players[pc].name), "%s", x);
-        players[pc].tt = 0ull;
-        players[pc].games = 0;
-        players[pc].depth = 0;
-        players[pc].moves = 0;
-        pc++;
+static void scan_chunk(table_t *t, const char *s, const char *end,
+                       entry_t *e) {
+  player_t *who[2] = { NULL, NULL };
+  int ne = 0;
+  int mn = 0;
+  int ctm = 0;
+
+  while (s < end) {
+    const char *eol = memchr(s, '\n', end - s);
+    if (eol == NULL) eol = end;
+
+    if (s[0] == '[') {
+      size_t n;
+      const char *v;
+      if (eol - s > 7 && strncmp(s + 1, "White ", 6) == 0 &&
+          (v = tag_value(s, eol, &n)) != NULL) {
+        end_game(who, e, ne);
+        ne = 0;
+        who[0] = table_get(t, v, n);
+        who[0]->games++;
+      } else if (eol - s > 7 && strncmp(s + 1, "Black ", 6) == 0 &&
+                 (v = tag_value(s, eol, &n)) != NULL) {
+        who[1] = table_get(t, v, n);
+        who[1]->games++;
       }
-      who[1] = players + i;
-      who[1]->games++;
+      s = eol + 1;
       continue;
     }
 
-    tc = ParseString(s, tok);
-
-    for (i = 0; i < tc; i++) {
-      if (Xisdigit(tok[i][0])
-          && tok[i][1] != '}'
-          && tok[i][2] != '}'
-          && tok[i][3] != '}'
-          && tok[i][4] != '}') {
-        mn = strtol(tok[i], (char **)NULL, 10);
-        ctm = 0;  // always white to move after a move number in PGN file
-        continue;
+    // movetext: move numbers "12." and comments "{time depth nodes}"
+    while (s < eol) {
+      if (*s == '{') {
+        const char *close = memchr(s, '}', eol - s);
+        if (close == NULL) break;
+        if (Xisdigit(s[1]) && ne < MAX_GAME_ENTRIES) {
+          char *p;
+          e[ne].t = strtoll(s + 1, &p, 10);
+          e[ne].d = strtol(p, &p, 10);
+          e[ne].n = strtoll(p, &p, 10);
+          e[ne].mn = mn;
+          e[ne].ctm = ctm;
+          ne++;
+        }
+        ctm = 1;
+        s = close + 1;
+      } else if (Xisdigit(*s)) {
+        char *p;
+        long x = strtol(s, &p, 10);
+        if (*p == '.') {
+          mn = x;
+          ctm = 0;  // always white to move after a move number in PGN file
+        }
+        s = p;
+        while (s < eol && *s != ' ' && *s != '\t') s++;
+      } else {
+        s++;
       }
+    }
+    s = eol + 1;
+  }
+  end_game(who, e, ne);
+}
+
+static void *worker(void *arg) {
+  table_t *t = arg;
+  entry_t *e = malloc(sizeof(entry_t) * MAX_GAME_ENTRIES);
+  while (true) {
+    int i = __sync_fetch_and_add(&next_chunk, 1);
+    if (i >= num_chunks) break;
+    scan_chunk(t, chunks[i].begin, chunks[i].end, e);
+  }
+  free(e);
+  return NULL;
+}
 
-      if (mn >= LAST_MOVE_NUMBER) continue;
+// Returns the start of the first game at or after s: a line starting with
+// '[' that follows a line which does not
+static const char *next_game_start(const char *base, const char *s,
+                                   const char *end) {
+  if (s <= base) return base;
+  if (s[-1] != '\n') {
+    s = memchr(s, '\n', end - s);
+    if (s == NULL) return end;
+    s++;
+  }
+  while (s < end) {
+    if (*s == '[') {
+      // find the start of the previous line
+      const char *prev = s - 1;
+      while (prev > base && prev[-1] != '\n') prev--;
+      if (prev == s - 1 || *prev != '[') return s;
+    }
+    s = memchr(s, '\n', end - s);
+    if (s == NULL) return end;
+    s++;
+  }
+  return end;
+}
 
-      if (tok[i][0] == '{') {
-        tq[q & 31] = strtoll(tok[i] + 1, (char **)NULL, 10);
-        dq[q & 31] = strtol(tok[i+1], (char **)NULL, 10);
-        nq[q & 31] = strtoll(tok[i+2], (char **)NULL, 10);
-        q++;
-        i += 2;  // we consumed 2 additional tokens
+static void merge_player(player_t *g, const player_t *p) {
+  g->games += p->games;
+  g->tt += p->tt;
+  g->depth += p->depth;
+  g->moves += p->moves;
+  g->nodes += p->nodes;
+  g->searched += p->searched;
+  g->overtime += p->overtime;
+  if (p->max_time > g->max_time) g->max_time = p->max_time;
+  for (int i = 0; i < MAX_DEPTH; i++) g->depth_bins[i] += p->depth_bins[i];
+  for (int i = 0; i < NPS_BINS; i++) g->nps_bins[i] += p->nps_bins[i];
+
+  if (p->per_move == NULL) return;
+  if (g->per_move == NULL) {
+    g->per_move = calloc(LAST_MOVE_NUMBER + 1, sizeof(move_stats_t));
+  }
+  for (int mn = 0; mn <= LAST_MOVE_NUMBER; mn++) {
+    move_stats_t *a = &g->per_move[mn];
+    const move_stats_t *b = &p->per_move[mn];
+    if (b->moves == 0) continue;
+    if (a->moves == 0 || b->min_depth < a->min_depth) a->min_depth = b->min_depth;
+    if (a->moves == 0 || b->max_depth > a->max_depth) a->max_depth = b->max_depth;
+    if (b->max_time > a->max_time) a->max_time = b->max_time;
+    a->moves += b->moves;
+    a->overtime += b->overtime;
+    a->time += b->time;
+    a->depth += b->depth;
+    a->nodes += b->nodes;
+    for (int i = 0; i < TIME_BINS; i++) a->time_bins[i] += b->time_bins[i];
+    for (int i = 0; i < MAX_DEPTH; i++) a->depth_bins[i] += b->depth_bins[i];
+  }
+  free(p->per_move);
+}
 
-        if (mn < 14) {
-          ctm = 1;
-          continue;
-        }
+// Value at quantile q of a histogram of total entries
+static int quantile_bin(const uint32_t *bins, int nbins, uint64_t total,
+                        double q) {
+  uint64_t target = (uint64_t) ceil(q * total);
+  if (target < 1) target = 1;
+  uint64_t sum = 0;
+  for (int i = 0; i < nbins; i++) {
+    sum += bins[i];
+    if (sum >= target) return i;
+  }
+  return nbins - 1;
+}
 
-        who[ctm]->tt += tq[(q-17) & 31];
-        who[ctm]->depth += dq[(q-17) & 31];
-        who[ctm]->nodes += nq[(q-17) & 31];
-        who[ctm]->moves++;
+static void print_details(player_t **sorted, int pc, int per_move) {
+  printf("   p1 kNPS   p10 kNPS   p50 kNPS   p90 kNPS   p99 kNPS   MAX TIME   OVERTIME   PLAYER\n");
+  printf(" ---------  ---------  ---------  ---------  ---------  ---------  ---------   ------\n");
+  for (int i = 0; i < pc; i++) {
+    player_t *p = sorted[i];
+    uint64_t total = 0;
+    for (int b = 0; b < NPS_BINS; b++) total += p->nps_bins[b];
+    double qs[5] = { 0.01, 0.10, 0.50, 0.90, 0.99 };
+    for (int k = 0; k < 5; k++) {
+      if (total == 0) {
+        printf(" %9s ", "-");
+      } else {
+        printf(" %9.1f ", nps_of_bin(quantile_bin(p->nps_bins, NPS_BINS, total, qs[k])) / 1000.0);
+      }
+    }
+    printf(" %9.4f ", p->max_time / 1000000000.0);
+    if (budget > 0) {
+      printf(" %9" PRId64 "   %s\n", p->overtime, p->name);
+    } else {
+      printf(" %9s   %s\n", "-", p->name);
+    }
+  }
+  printf("\n");
 
-        /*
-        if (dq[ (q-17) & 31 ] != 10) {
-          printf("Line number: %d move number = %d\n", ln, mn);
-          exit(0);
-        }
-        */
+  if (!per_move) return;
 
-        ctm = 1;
+  for (int i = 0; i < pc; i++) {
+    player_t *p = sorted[i];
+    printf("%s: %" PRId64 " searched moves, depth distribution:\n ", p->name, p->searched);
+    for (int d = 0; d < MAX_DEPTH; d++) {
+      if (p->depth_bins[d] != 0) {
+        printf(" %d:%.1f%%", d, 100.0 * p->depth_bins[d] / p->searched);
       }
     }
+    printf("\n\n");
+    if (p->per_move == NULL) continue;
+
+    printf("  MOVE   MOVES   ave TIME   p50 TIME   p90 TIME   MAX TIME  ave DEPTH  MIN  MAX  ave NODES  OVERTIME\n");
+    for (int mn = 0; mn <= LAST_MOVE_NUMBER; mn++) {
+      move_stats_t *m = &p->per_move[mn];
+      if (m->moves == 0) continue;
+      double p50 = fmin(time_of_bin(quantile_bin(m->time_bins, TIME_BINS, m->moves, 0.5)), m->max_time);
+      double p90 = fmin(time_of_bin(quantile_bin(m->time_bins, TIME_BINS, m->moves, 0.9)), m->max_time);
+      printf("  %3d%s %7u  %9.4f  %9.4f  %9.4f  %9.4f  %9.3f  %3d  %3d  %9.0f  %8u\n",
+             mn, mn == LAST_MOVE_NUMBER ? "+" : " ", m->moves,
+             m->time / m->moves / 1e9, p50 / 1e9, p90 / 1e9, m->max_time / 1e9,
+             m->depth / m->moves, m->min_depth, m->max_depth,
+             m->nodes / m->moves, m->overtime);
+    }
+    printf("\n");
   }
+}
+
+static void usage() {
+  printf("Usage: pgnstats [-t threads] [-b budget_sec] [-m] file.pgn [reference]\n");
+  printf("  -t  number of threads (default: all cpus)\n");
+  printf("  -b  count the moves that took longer than budget_sec\n");
+  printf("  -m  print depth, time and node distributions per move number\n");
+}
+
+int main(int argc, char *argv[]) {
+  int             i;
+  int             j;
+  char            ref[64];   // reference player if not specified
+  int             rix = 0;   // reference index
+  int             threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int             per_move = 0;
+  int             opt;
+
+  while ((opt = getopt(argc, argv, "t:b:mh")) != -1) {
+    switch (opt) {
+      case 't': threads = atoi(optarg); break;
+      case 'b': budget = (int64_t) (atof(optarg) * 1000000000.0); break;
+      case 'm': per_move = 1; break;
+      default: usage(); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind >= argc) {
+    usage();
+    return 1;
+  }
+  if (threads < 1) threads = 1;
+
+  printf("\n");
+  int fd = open(argv[optind], O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    perror(argv[optind]);
+    return 1;
+  }
+
+  snprintf(ref, sizeof(ref), "%s", "");
+  if (argc > optind + 1) {
+    snprintf(ref, sizeof(ref), "%s", argv[optind + 1]);
+  }
+
+  const char *base = "";
+  size_t size = st.st_size;
+  if (size > 0) {
+    base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED) {
+      perror("mmap");
+      return 1;
+    }
+    madvise((void *) base, size, MADV_SEQUENTIAL);
+  }
+  const char *end = base + size;
+
+  // split at game boundaries
+  num_chunks = threads * CHUNKS_PER_THREAD;
+  chunks = malloc(sizeof(chunk_t) * num_chunks);
+  const char *prev = base;
+  int nc = 0;
+  for (i = 1; i <= num_chunks; i++) {
+    const char *b = (i == num_chunks) ? end :
+        next_game_start(base, base + size / num_chunks * i, end);
+    if (b > prev) {
+      chunks[nc].begin = prev;
+      chunks[nc].end = b;
+      nc++;
+      prev = b;
+    }
+  }
+  num_chunks = nc;
+
+  table_t *tables = malloc(sizeof(table_t) * threads);
+  pthread_t *tids = malloc(sizeof(pthread_t) * threads);
+  for (i = 0; i < threads; i++) {
+    table_init(&tables[i]);
+    pthread_create(&tids[i], NULL, worker, &tables[i]);
+  }
+  for (i = 0; i < threads; i++) pthread_join(tids[i], NULL);
+
+  // merge the tables in thread order
+  table_t all;
+  table_init(&all);
+  for (i = 0; i < threads; i++) {
+    for (j = 0; j < tables[i].pc; j++) {
+      player_t *p = &tables[i].players[j];
+      merge_player(table_get(&all, p->name, strlen(p->name)), p);
+    }
+  }
+  int pc = all.pc;
+  player_t *players = all.players;
 
   for (i = 0; i < pc; i++) {
     double se = players[i].tt / 1000000000.0;  // convert to seconds
@@ -163,21 +535,24 @@ int main(int argc, char *argv[]) {
     players[i].nm = players[i].nodes / 1000000.0 / (double) players[i].moves;
   }
 
+  player_t **sorted = malloc(sizeof(player_t *) * (pc + 1));
+  for (i = 0; i < pc; i++) sorted[i] = players + i;
+
   for (i = 0; i < pc-1; i++)
     for (j = i+1; j < pc; j++)
-      if (players[j].ts < players[i].ts) {
-        player_t  tmp = players[i];
-        players[i] = players[j];
-        players[j] = tmp;
+      if (sorted[j]->ts < sorted[i]->ts) {
+        player_t  *tmp = sorted[i];
+        sorted[i] = sorted[j];
+        sorted[j] = tmp;
       }
 
   rix= 0;
 
   int  biggest = 0;
   for (i = 0; i < pc; i++) {
-    int  cc = strlen(players[i].name);
+    int  cc = strlen(sorted[i]->name);
     if (cc > biggest) biggest = cc;
-    if (0 == strcmp(players[i].name, ref))
+    if (0 == strcmp(sorted[i]->name, ref))
       rix = i;
   }
 
@@ -191,16 +566,17 @@ int main(int argc, char *argv[]) {
 
   for (i = 0; i < pc; i++) {
     printf("%10.4f  %10.3f  %8.3f  %8.3f  %8.3f  %9.4f  %7d   %s\n",
-           players[i].ts,
-           players[i].ts / players[rix].ts,
-           log(players[i].ts / players[rix].ts),
-           players[i].nm,
-           log(players[i].nm / players[rix].nm),
-           players[i].depth  / (double) players[i].moves,
-           players[i].games,
-           players[i].name);
+           sorted[i]->ts,
+           sorted[i]->ts / sorted[rix]->ts,
+           log(sorted[i]->ts / sorted[rix]->ts),
+           sorted[i]->nm,
+           log(sorted[i]->nm / sorted[rix]->nm),
+           sorted[i]->depth  / (double) sorted[i]->moves,
+           sorted[i]->games,
+           sorted[i]->name);
   }
 
   printf("\n");
+  print_details(sorted, pc, per_move);
   return 0;
 }
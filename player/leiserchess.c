@@ -1,6 +1,7 @@
 // Copyright (c) 2015 MIT License by 6.172 Staff
 
 #include <ctype.h>
+#include <errno.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -12,13 +13,11 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
-#include <cilk/cilk.h>
-#include <cilk/reducer.h>
-#include <cilk/cilk_api.h>
-
 #include "./eval.h"
 #include "./fen.h"
 #include "./move_gen.h"
+#include "./parallel.h"
+#include "./perfstat.h"
 #include "./search.h"
 #include "./tbassert.h"
 #include "./tt.h"
@@ -40,6 +39,10 @@ char  VERSION[] = "1038";
 static FILE *OUT;
 static FILE *IN;
 
+// "startpos", "endgame" or "fen <fen>": how gme[0] was last set up
+#define MAX_CHARS_IN_POSITION_BASE (MAX_FEN_CHARS + 8)
+static char position_base[MAX_CHARS_IN_POSITION_BASE];
+
 // Options for UCI interface
 
 // defined in search.c
@@ -51,6 +54,9 @@ extern int USE_NMM;
 extern int FUT_DEPTH;
 extern int TRACE_MOVES;
 extern int DETECT_DRAWS;
+extern int MULTIPV;
+extern int PV_SPLIT;
+extern int SERIAL_DEPTH;
 
 // defined in eval.c
 extern int RANDOMIZE;
@@ -101,6 +107,9 @@ static int_options iopts[] = {
   { "lmr_r2",                   &LMR_R2,   20,                    1,              MAX_NUM_MOVES },
   { "hmb",                         &HMB,   0.03 * PAWN_VALUE,     0,              PAWN_VALUE    },
   { "fut_depth",             &FUT_DEPTH,   3,                     0,              5             },
+  { "multipv",                 &MULTIPV,   1,                     1,              MAX_MULTIPV   },
+  { "pv_split",               &PV_SPLIT,   1,                     0,              1             },
+  { "serial_depth",       &SERIAL_DEPTH,   3,                     0,              MAX_PLY_IN_SEARCH },
   // debug options
   { "use_nmm",                 &USE_NMM,   1,                     0,              1             },
   { "detect_draws",       &DETECT_DRAWS,   1,                     0,              1             },
@@ -130,25 +139,7 @@ void lower_case(char *s) {
 // makes the move described by 'mvstring'
 victims_t make_from_string(position_t *old, position_t *p,
                            const char *mvstring) {
-  sortable_move_t lst[MAX_NUM_MOVES];
-  move_t mv = 0;
-  // make copy so that mvstring can be a constant
-  char string[MAX_CHARS_IN_MOVE];
-  int move_count = generate_all_opt(old, lst, true);
-
-  snprintf(string, MAX_CHARS_IN_MOVE, "%s", mvstring);
-  lower_case(string);
-
-  for (int i = 0; i < move_count; i++) {
-    char buf[MAX_CHARS_IN_MOVE];
-    move_to_str(get_move(lst[i]), buf, MAX_CHARS_IN_MOVE);
-    lower_case(buf);
-
-    if (strcmp(buf, string) == 0) {
-      mv = get_move(lst[i]);
-      break;
-    }
-  }
+  move_t mv = str_to_move(old, mvstring);
   return (mv == 0) ? ILLEGAL() : make_move(old, p, mv);
 }
 
@@ -167,7 +158,8 @@ static move_t bestMoveSoFar;
 static char theMove[MAX_CHARS_IN_MOVE];
 
 static pthread_mutex_t entry_mutex;
-static uint64_t node_count_serial;
+static nodeCounter node_count_serial;
+static searchState uci_state;  // zero-initialized, like init_search_state
 
 typedef struct {
   position_t *p;
@@ -175,6 +167,24 @@ typedef struct {
   double tme;
 } entry_point_args;
 
+#if PARPROF
+// The work/span profile of one iteration: parallelism is work over span,
+// the most speedup the iteration could show on any number of workers.
+static void print_parprof(FILE *out, int depth, parprof_report_t *prof,
+                          uint64_t nodes) {
+  uint64_t *count = prof->count;
+  fprintf(out, "info parprof depth %d work %.1f ms span %.1f ms parallelism %.2f"
+          " loops %" PRIu64 " iterations %" PRIu64 " steals %" PRIu64
+          " cutoffs %" PRIu64 " aborted %" PRIu64 " wasted_nodes %" PRIu64
+          " (%.1f%% of %" PRIu64 ")\n", depth, prof->work, prof->span,
+          prof->span > 0 ? prof->work / prof->span : 1.0,
+          count[PARPROF_LOOPS], count[PARPROF_ITERATIONS], prof->steals,
+          count[PARPROF_CUTOFFS], count[PARPROF_ABORTED],
+          count[PARPROF_WASTED_NODES],
+          nodes > 0 ? 100.0 * count[PARPROF_WASTED_NODES] / nodes : 0.0, nodes);
+}
+#endif
+
 void *entry_point(void *arg) {
   move_t subpv[MAX_PLY_IN_SEARCH];
 
@@ -188,16 +198,26 @@ void *entry_point(void *arg) {
   // start time of search
   init_abort_timer(tme);
 
-  init_best_move_history();
+  init_best_move_history(&uci_state);
   tt_age_hashtable();
 
-  init_tics();
+  par_begin();
 
   for (int d = 1; d <= depth; d++) {  // Iterative deepening
     reset_abort();
 
+#if PARPROF
+    uint64_t nodes_before = node_counter_total(&node_count_serial);
+    parprof_begin();
+#endif
     searchRoot(p, -INF, INF, d, 0, subpv, &node_count_serial,
-                OUT);
+                OUT, &uci_state);
+#if PARPROF
+    parprof_report_t prof;
+    parprof_end(&prof);
+    print_parprof(OUT, d, &prof,
+                  node_counter_total(&node_count_serial) - nodes_before);
+#endif
 
     et = elapsed_time();
     bestMoveSoFar = subpv[0];
@@ -211,6 +231,7 @@ void *entry_point(void *arg) {
     // don't start iteration that you cannot complete
     if (et > tme * RATIO_FOR_TIMEOUT) break;
   }
+  par_end();
 
   // This unlock will allow the main thread lock/unlock in UCIBeginSearch to
   // proceed
@@ -227,7 +248,7 @@ void UciBeginSearch(position_t *p, int depth, double tme) {
   args.depth = depth;
   args.p = p;
   args.tme = tme;
-  node_count_serial = 0;
+  node_counter_reset(&node_count_serial);
   entry_point(&args);
 
   char bms[MAX_CHARS_IN_MOVE];
@@ -237,6 +258,314 @@ void UciBeginSearch(position_t *p, int depth, double tme) {
   return;
 }
 
+// -----------------------------------------------------------------------------
+// bench [<depth>] [serial|parallel]
+//
+// Searches the current position to the given depth twice, serially and then
+// with the parallel search, each from an empty hash table and the same root
+// move order.  The parallel search spends time on all workers, so the ratio
+// of that work to the serial time is the overhead of parallelism; with one
+// worker it is the cost of the splits alone, which serial_depth trades
+// against the parallelism exposed.  Given a mode, only that search is run,
+// as scaling_bench.py does for each number of workers.
+// -----------------------------------------------------------------------------
+
+#define BENCH_DEFAULT_DEPTH 6
+
+typedef struct {
+  move_t    best_move;
+  score_t   score;
+  uint64_t  nodes;
+  double    time;   // milliseconds
+  uint64_t  ticks;  // time stamp counter, see perfstat.h
+} bench_result_t;
+
+static searchState bench_state;
+static nodeCounter bench_nodes;
+
+// With counts, also reads the counters opened by perfstat_open and times the
+// phases of the search.
+static void bench_search(position_t *p, int depth, bool serial,
+                         perfstat_counts_t *counts, bench_result_t *result) {
+  move_t pv[MAX_PLY_IN_SEARCH];
+
+  tt_clear_hashtable();
+  init_search_state(&bench_state);  // both runs shuffle the root moves alike
+  bench_state.serial = serial;
+  init_abort_timer(INF_TIME);
+
+  node_counter_reset(&bench_nodes);
+  result->best_move = 0;
+  if (counts != NULL) {
+    perfstat_phases_reset();
+    perfstat_start();
+  }
+  uint64_t start_ticks = perfstat_ticks();
+  double start = milliseconds();
+  par_begin();
+  for (int d = 1; d <= depth; d++) {  // Iterative deepening
+    reset_abort();
+    pv[0] = 0;
+    result->score = searchRoot(p, -INF, INF, d, 0, pv, &bench_nodes,
+                               NULL, &bench_state);
+    result->best_move = pv[0];
+  }
+  par_end();
+  result->time = milliseconds() - start;
+  result->ticks = perfstat_ticks() - start_ticks;
+  if (counts != NULL) {
+    perfstat_stop(counts);
+  }
+  result->nodes = node_counter_total(&bench_nodes);
+}
+
+static void bench_print(FILE *out, const char *name, bench_result_t *result) {
+  char bms[MAX_CHARS_IN_MOVE];
+  move_to_str(result->best_move, bms, MAX_CHARS_IN_MOVE);
+  double ms = result->time > 1 ? result->time : 1;
+  fprintf(out, "bench %s bestmove %s score cp %d nodes %" PRIu64
+          " time %d nps %" PRIu64 "\n", name, bms, result->score,
+          result->nodes, (int) result->time,
+          (uint64_t) (1000 * result->nodes / ms));
+}
+
+void run_bench(position_t *p, int depth, const char *mode) {
+  bench_result_t serial;
+  bench_result_t parallel;
+  if (mode != NULL) {
+    bool is_serial = (strcmp(mode, "serial") == 0);
+    bench_search(p, depth, is_serial, NULL, &serial);
+    bench_print(OUT, is_serial ? "serial" : "parallel", &serial);
+    tt_clear_hashtable();
+    return;
+  }
+  bench_search(p, depth, true, NULL, &serial);
+  bench_search(p, depth, false, NULL, &parallel);
+
+  int workers = par_num_workers();
+  double serial_ms = serial.time > 1 ? serial.time : 1;
+  double parallel_ms = parallel.time > 1 ? parallel.time : 1;
+  bench_print(OUT, "serial", &serial);
+  bench_print(OUT, "parallel", &parallel);
+  fprintf(OUT, "bench workers %d serial_depth %d speedup %.2f overhead %.1f%%"
+          " extra_nodes %.1f%%\n", workers, SERIAL_DEPTH,
+          serial_ms / parallel_ms,
+          100.0 * (parallel_ms * workers / serial_ms - 1),
+          100.0 * ((double) parallel.nodes / (serial.nodes ? serial.nodes : 1) - 1));
+  tt_clear_hashtable();
+}
+
+// -----------------------------------------------------------------------------
+// perfstat [<depth>]
+//
+// Runs the serial search of bench under the hardware performance counters
+// and reports each counter in total and per node, and the IPC.  The counters
+// follow the calling thread only, hence the serial search.  Where the kernel
+// or the cpu refuses a counter it is reported unavailable, and the search
+// still runs.  Built with PERFSTAT=1, the share of the search's time stamp
+// counter ticks spent in each phase (movegen, eval, make_move, tt) follows.
+// -----------------------------------------------------------------------------
+
+void run_perfstat(position_t *p, int depth) {
+  if (perfstat_open() == 0) {
+    const char *hint = "";
+    if (errno == EACCES || errno == EPERM) {
+      hint = " (see /proc/sys/kernel/perf_event_paranoid)";
+    } else if (errno == ENOENT || errno == EOPNOTSUPP) {
+      hint = " (no hardware counters, as in many virtual machines)";
+    }
+    fprintf(OUT, "perfstat counters unavailable: %s%s\n", strerror(errno), hint);
+  }
+  perfstat_counts_t counts;
+  bench_result_t result;
+  bench_search(p, depth, true, &counts, &result);
+  perfstat_close();
+  bench_print(OUT, "serial", &result);
+
+  double nodes = result.nodes > 0 ? result.nodes : 1;
+  for (int e = 0; e < PERFSTAT_NUM_EVENTS; e++) {
+    if (counts.valid[e]) {
+      fprintf(OUT, "perfstat %s %" PRIu64 " per_node %.2f\n",
+              perfstat_event_name[e], counts.count[e], counts.count[e] / nodes);
+    } else {
+      fprintf(OUT, "perfstat %s unavailable\n", perfstat_event_name[e]);
+    }
+  }
+  if (counts.valid[PERFSTAT_CYCLES] && counts.valid[PERFSTAT_INSTRUCTIONS] &&
+      counts.count[PERFSTAT_CYCLES] > 0) {
+    fprintf(OUT, "perfstat ipc %.2f\n",
+            (double) counts.count[PERFSTAT_INSTRUCTIONS] /
+            counts.count[PERFSTAT_CYCLES]);
+  }
+
+  perfstat_phases_t phases;
+  perfstat_phases_read(&phases);
+  double ticks = result.ticks > 0 ? result.ticks : 1;
+  for (int ph = 0; ph < PERFSTAT_NUM_PHASES; ph++) {
+    if (phases.calls[ph] == 0) {
+      continue;
+    }
+    fprintf(OUT, "perfstat phase %s calls %" PRIu64 " per_node %.2f"
+            " ticks_per_call %.1f share %.1f%%\n", perfstat_phase_name[ph],
+            phases.calls[ph], phases.calls[ph] / nodes,
+            (double) phases.ticks[ph] / phases.calls[ph],
+            100.0 * phases.ticks[ph] / ticks);
+  }
+  tt_clear_hashtable();
+}
+
+// -----------------------------------------------------------------------------
+// Batch analysis: leiserchess --batch <file.epd> --depth <d> --threads <t>
+//
+// Streams positions (one FEN per line, optionally followed by "; <ops>") and
+// searches up to BATCH_CHUNK of them at a time, one position per strand.  Each
+// position is searched serially with its own searchState, so the parallelism
+// comes from running many positions at once rather than from splitting a
+// single search tree.  Results are printed in input order, one line each.
+//
+// Each position starts from a fresh searchState whose root move shuffle is
+// seeded with its line number, so it does not depend on the other positions.
+// The transposition table, however, is shared: with one thread the positions
+// run in input order and the results are reproducible for a given file, but
+// scores and node counts can depend on the positions searched before, and
+// with more threads on which positions happened to run concurrently.
+// -----------------------------------------------------------------------------
+
+#define BATCH_CHUNK 256
+#define BATCH_DEFAULT_DEPTH 6
+#define MAX_CHARS_IN_BATCH_LINE 1024
+
+typedef struct {
+  char         line[MAX_CHARS_IN_BATCH_LINE];  // FEN part of the input line
+  int          lineno;         // of the input line, seeds the root shuffle
+  char        *ops;            // anything after the ';' in the input line
+  bool         valid;          // whether the FEN parsed
+  position_t   position;
+  searchState  state;
+  move_t       best_move;
+  score_t      score;
+  nodeCounter  counter;
+  uint64_t     nodes;          // total of counter
+  double       time;           // milliseconds
+} batch_task_t;
+
+static void batch_search(batch_task_t *task, int depth) {
+  move_t pv[MAX_PLY_IN_SEARCH];
+  double start = milliseconds();
+
+  node_counter_reset(&task->counter);
+  task->best_move = 0;
+  init_search_state(&task->state);  // no killers left by the slot's last use
+  task->state.serial = true;
+  task->state.rng = task->lineno;
+
+  for (int d = 1; d <= depth; d++) {  // Iterative deepening
+    pv[0] = 0;
+    task->score = searchRoot(&task->position, -INF, INF, d, 0, pv,
+                             &task->counter, NULL, &task->state);
+    task->best_move = pv[0];
+  }
+  task->time = milliseconds() - start;
+  task->nodes = node_counter_total(&task->counter);
+}
+
+// The tasks of run_batch searched in one parallel loop.
+typedef struct {
+  batch_task_t *tasks;
+  int           depth;
+} batch_chunk_t;
+
+static void batch_search_task(void *ctx, int i) {
+  batch_chunk_t *chunk = (batch_chunk_t *) ctx;
+  if (chunk->tasks[i].valid) {
+    batch_search(&chunk->tasks[i], chunk->depth);
+  }
+}
+
+static void batch_print(FILE *out, batch_task_t *task) {
+  if (!task->valid) {
+    fprintf(out, "%s; error invalid fen\n", task->line);
+    return;
+  }
+  char bms[MAX_CHARS_IN_MOVE];
+  move_to_str(task->best_move, bms, MAX_CHARS_IN_MOVE);
+  fprintf(out, "%s; bestmove %s; score cp %d; nodes %" PRIu64 "; time %d",
+          task->line, bms, task->score, task->nodes, (int) task->time);
+  if (task->ops != NULL) {
+    fprintf(out, ";%s", task->ops);
+  }
+  fprintf(out, "\n");
+}
+
+// Reads the next non-empty, non-comment line into task.  Returns false at EOF.
+// *lineno counts the lines read so far.
+static bool batch_read(FILE *in, batch_task_t *task, int *lineno) {
+  while (fgets(task->line, MAX_CHARS_IN_BATCH_LINE, in) != NULL) {
+    task->lineno = ++*lineno;
+    task->line[strcspn(task->line, "\r\n")] = '\0';
+    char *start = task->line + strspn(task->line, " \t");
+    if (*start == '\0' || *start == '#') {
+      continue;
+    }
+    memmove(task->line, start, strlen(start) + 1);
+
+    task->ops = strchr(task->line, ';');
+    if (task->ops != NULL) {
+      *task->ops++ = '\0';
+    }
+    size_t len = strlen(task->line);
+    while (len > 0 && isspace((unsigned char) task->line[len - 1])) {
+      task->line[--len] = '\0';
+    }
+    // fen_to_pos is not reentrant, so positions are set up while reading.
+    task->valid = (fen_to_pos(&task->position, task->line) == 0);
+    return true;
+  }
+  return false;
+}
+
+int run_batch(const char *filename, int depth) {
+  FILE *in = fopen(filename, "r");
+  if (in == NULL) {
+    fprintf(stderr, "Cannot open batch file %s\n", filename);
+    return 1;
+  }
+
+  // aligned for the cache-line slots of the node counters
+  batch_task_t *tasks;
+  if (posix_memalign((void **) &tasks, __alignof__(batch_task_t),
+                     sizeof(batch_task_t) * BATCH_CHUNK) != 0) {
+    fprintf(stderr, "Out of memory for batch tasks\n");
+    fclose(in);
+    return 1;
+  }
+  init_abort_timer(INF_TIME);
+  reset_abort();
+  tt_age_hashtable();
+
+  int lineno = 0;
+  bool done = false;
+  while (!done) {
+    int num_tasks = 0;
+    while (num_tasks < BATCH_CHUNK && batch_read(in, &tasks[num_tasks], &lineno)) {
+      num_tasks++;
+    }
+    done = (num_tasks < BATCH_CHUNK);
+
+    batch_chunk_t chunk = { tasks, depth };
+    par_for(0, num_tasks, batch_search_task, &chunk, NULL);
+
+    for (int i = 0; i < num_tasks; i++) {
+      batch_print(OUT, &tasks[i]);
+    }
+    fflush(OUT);
+  }
+
+  free(tasks);
+  fclose(in);
+  return 0;
+}
+
 // -----------------------------------------------------------------------------
 // argparse help
 // -----------------------------------------------------------------------------
@@ -244,6 +573,10 @@ void UciBeginSearch(position_t *p, int depth, double tme) {
 // print help messages in uci
 void help()  {
   printf("eval      - Evaluate current position.\n");
+  printf("bench     - Search the current position serially and in parallel, and report\n");
+  printf("            the overhead of the parallel search.  Takes a depth (default %d),\n",
+         BENCH_DEFAULT_DEPTH);
+  printf("            and optionally serial or parallel to run only that search.\n");
   printf("display   - Display current board state.\n");
   printf("generate  - Generate all possible moves.\n");
   printf("go        - Search from current state.  Possible arguments are:\n");
@@ -264,6 +597,9 @@ void help()  {
   printf("            Used to verify move the generator.\n");
   printf("            Sample usage: \n");
   printf("                depth 3: generate all possible moves for depth 1--3\n");
+  printf("perfstat  - Run the serial bench search under the hardware performance counters\n");
+  printf("            and report cycles, instructions, IPC and misses per node.  Takes a\n");
+  printf("            depth (default %d).\n", BENCH_DEFAULT_DEPTH);
   printf("position  - Set up the board using the fenstring given.  Possible arguments are:\n");
   printf("            startpos:     set up the board with default starting position.\n");
   printf("            endgame:      set up the board with endgame configuration.\n");
@@ -278,6 +614,7 @@ void help()  {
   printf("            Sample usage: \n");
   printf("                setoption name fut_depth value 4: set fut_depth to 4\n");
   printf("uci       - Display UCI version and options\n");
+  printf("ucinewgame - Clear the transposition table before a new game.\n");
   printf("\n");
 }
 
@@ -401,16 +738,38 @@ int main(int argc, char *argv[]) {
   setbuf(stdin, NULL);
 
   OUT = stdout;
-  if (argc > 1) {
-    IN = fopen(argv[1], "r");
-  } else {
-    IN = stdin;
+  IN = stdin;
+
+  // batch mode: --batch <file> [--depth <d>] [--threads <t>]
+  char *batch_file = NULL;
+  int   batch_depth = BATCH_DEFAULT_DEPTH;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+      batch_file = argv[++i];
+    } else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+      batch_depth = strtol(argv[++i], (char **)NULL, 10);
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      // must happen before the parallel runtime starts up
+      if (par_set_workers(argv[++i]) != 0) {
+        fprintf(stderr, "Invalid thread count %s\n", argv[i]);
+        return 1;
+      }
+    } else if (IN == stdin) {
+      IN = fopen(argv[i], "r");
+    }
   }
 
   init_options();
   init_eval();
   init_zob();
 
+  if (batch_file != NULL) {
+    tt_make_hashtable(HASH);
+    int status = run_batch(batch_file, batch_depth);
+    tt_free_hashtable();
+    return status;
+  }
+
   char **tok = (char **) malloc(sizeof(char *) * MAX_CHARS_IN_TOKEN * MAX_PLY_IN_GAME);
   int   ix = 0;  // index of which position we are operating on
 
@@ -421,6 +780,7 @@ int main(int argc, char *argv[]) {
 
   tt_make_hashtable(HASH);   // initial hash table
   fen_to_pos(&gme[ix], "");  // initialize with an actual position
+  snprintf(position_base, sizeof(position_base), "startpos");
 
   //  Check to make sure we don't loop infinitely if we don't get input.
   bool saw_input = false;
@@ -453,30 +813,55 @@ int main(int argc, char *argv[]) {
           continue;
         }
 
-        if (strcmp(tok[1], "startpos") == 0) {
-          ix = 0;
-          fen_to_pos(&gme[ix], "");
-          n = 2;
-        } else if (strcmp(tok[1], "endgame") == 0) {
-          ix = 0;
-          if (BOARD_WIDTH == 10)
-            fen_to_pos(&gme[ix], "ss9/10/10/10/10/10/10/10/10/9NN W");
-          else if (BOARD_WIDTH == 8)
-            fen_to_pos(&gme[ix], "ss7/8/8/8/8/8/8/7NN W");
+        // GUIs resend the whole game with every position command.  If the
+        // base position is unchanged, the moves that gme[] already holds
+        // are matched and only the new ones are made.
+        char base[MAX_CHARS_IN_POSITION_BASE] = "";
+        if (strcmp(tok[1], "startpos") == 0 || strcmp(tok[1], "endgame") == 0) {
+          snprintf(base, sizeof(base), "%s", tok[1]);
           n = 2;
         } else if (strcmp(tok[1], "fen") == 0) {
           if (token_count < 3) {  // no input
             fprintf(OUT, "Third argument (the fen string) required.\n");
             continue;
           }
-          ix = 0;
-          fen_to_pos(&gme[ix], tok[2]);
+          snprintf(base, sizeof(base), "fen %s", tok[2]);
           n = 3;
         }
 
+        int game_ix = ix;  // number of moves of the current game to reuse
+        if (base[0] != '\0' && strcmp(base, position_base) != 0) {
+          int err = 0;
+          if (strcmp(tok[1], "startpos") == 0) {
+            err = fen_to_pos(&gme[0], "");
+          } else if (strcmp(tok[1], "endgame") == 0) {
+            if (BOARD_WIDTH == 10)
+              err = fen_to_pos(&gme[0], "ss9/10/10/10/10/10/10/10/10/9NN W");
+            else if (BOARD_WIDTH == 8)
+              err = fen_to_pos(&gme[0], "ss7/8/8/8/8/8/8/7NN W");
+          } else {
+            err = fen_to_pos(&gme[0], tok[2]);
+          }
+          snprintf(position_base, sizeof(position_base), "%s", err ? "" : base);
+          game_ix = 0;
+        }
+        if (base[0] != '\0') {
+          ix = 0;
+        } else {
+          game_ix = 0;  // no base position: make the moves on the current one
+        }
+
         int save_ix = ix;
         if (token_count > n+1) {
           for (int j = n + 1; j < token_count; j++) {
+            if (ix - save_ix < game_ix) {
+              move_t mv = str_to_move(&gme[ix], tok[j]);
+              if (mv != 0 && mv == gme[ix+1].last_move) {
+                ix++;
+                continue;
+              }
+              game_ix = 0;  // the games diverge here
+            }
             victims_t victims = make_from_string(&gme[ix], &gme[ix+1], tok[j]);
             if (is_ILLEGAL(victims)) {
               fprintf(OUT, "info string Move %s is illegal\n", tok[j]);
@@ -523,6 +908,11 @@ int main(int argc, char *argv[]) {
         continue;
       }
 
+      if (strcmp(tok[0], "ucinewgame") == 0) {  // forget the previous game
+        tt_clear_hashtable();
+        continue;
+      }
+
       if (strcmp(tok[0], "setoption") == 0) {
         int sostate = 0;
         char  name[MAX_CHARS_IN_TOKEN];
@@ -590,6 +980,8 @@ int main(int argc, char *argv[]) {
                        tt_get_num_of_records(), tt_get_bytes_per_record());
                 printf("info string Total hash table size: %zu bytes\n",
                        tt_get_num_of_records() * tt_get_bytes_per_record());
+                printf("info string Hash table backed by %zu KB pages\n",
+                       tt_get_page_size() >> 10);
               }
               break;
             }
@@ -677,6 +1069,32 @@ int main(int argc, char *argv[]) {
         continue;
       }
 
+      if (strcmp(tok[0], "bench") == 0) {
+        int depth = BENCH_DEFAULT_DEPTH;
+        if (token_count >= 2) {
+          depth = strtol(tok[1], (char **)NULL, 10);
+        }
+        char *mode = NULL;
+        if (token_count >= 3) {
+          if (strcmp(tok[2], "serial") != 0 && strcmp(tok[2], "parallel") != 0) {
+            fprintf(OUT, "Unknown bench mode %s\n", tok[2]);
+            continue;
+          }
+          mode = tok[2];
+        }
+        run_bench(&gme[ix], depth, mode);
+        continue;
+      }
+
+      if (strcmp(tok[0], "perfstat") == 0) {
+        int depth = BENCH_DEFAULT_DEPTH;
+        if (token_count >= 2) {
+          depth = strtol(tok[1], (char **)NULL, 10);
+        }
+        run_perfstat(&gme[ix], depth);
+        continue;
+      }
+
       if (strcmp(tok[0], "perft") == 0) {  // Test move generator
         // Correct output to depth 4
         // perft  1 62
@@ -689,6 +1107,7 @@ int main(int argc, char *argv[]) {
           depth = strtol(tok[1], (char **)NULL, 10);
         }
         do_perft(gme, depth, 0);
+        position_base[0] = '\0';  // do_perft resets gme[0]
         continue;
       }
 
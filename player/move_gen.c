@@ -2,6 +2,7 @@
 
 #include "./move_gen.h"
 
+#include <ctype.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -194,6 +195,99 @@ void move_to_str(move_t mv, char *buf, size_t bufsize) {
   }
 }
 
+// parses a square in the notation of square_to_str, returns number of
+// characters read or 0 if s does not start with a square on the board
+static int str_to_square(const char *s, square_t *sq) {
+  int f = tolower((unsigned char) s[0]) - 'a';
+  int r = s[1] - '0';
+  if (f < 0 || f >= BOARD_WIDTH || r < 0 || r >= BOARD_WIDTH) {
+    return 0;
+  }
+  *sq = square_of(f, r);
+  return 2;
+}
+
+// converts a move in the notation of move_to_str (case-insensitive) into a
+// move_t for position p.  Returns 0 unless it is one of the moves that
+// generate_all_opt would produce for p.
+move_t str_to_move(position_t *p, const char *mvstring) {
+  square_t from_sq, to_sq;
+  rot_t rot = NONE;
+  int len = str_to_square(mvstring, &from_sq);
+  if (len == 0) {
+    return 0;
+  }
+  mvstring += len;
+
+  switch (tolower((unsigned char) *mvstring)) {
+    case 'r':
+      rot = RIGHT;
+      to_sq = from_sq;
+      mvstring++;
+      break;
+    case 'u':
+      rot = UTURN;
+      to_sq = from_sq;
+      mvstring++;
+      break;
+    case 'l':
+      rot = LEFT;
+      to_sq = from_sq;
+      mvstring++;
+      break;
+    default:
+      len = str_to_square(mvstring, &to_sq);
+      if (len == 0) {
+        return 0;
+      }
+      mvstring += len;
+      break;
+  }
+  if (*mvstring != '\0') {
+    return 0;
+  }
+
+  color_t color_to_move = color_to_move_of(p);
+  piece_t x = p->board[from_sq];
+  ptype_t typ = ptype_of(x);
+  if ((typ != KING && typ != PAWN) || color_of(x) != color_to_move) {
+    return 0;
+  }
+
+  if (to_sq == from_sq) {
+    if (rot == NONE && typ != KING) {  // only Kings have a null move
+      return 0;
+    }
+  } else {
+    bool adjacent = false;
+    for (int d = 0; d < 8; d++) {
+      if (from_sq + dir_of(d) == to_sq) {
+        adjacent = true;
+        break;
+      }
+    }
+    if (!adjacent) {
+      return 0;
+    }
+    piece_t y = p->board[to_sq];
+    ptype_t to_typ = ptype_of(y);
+    if (!(to_typ == EMPTY ||
+          (typ == PAWN && to_typ == PAWN && color_of(y) != color_to_move))) {
+      return 0;
+    }
+  }
+
+  if (typ == PAWN) {  // Pawns pinned down by the enemy laser cannot move
+    char laser_map[ARR_SIZE];
+    mark_laser_path(p, laser_map, opp_color(color_to_move));
+    if (laser_map[from_sq] == 1) {
+      return 0;
+    }
+  }
+
+  return move_of(typ, rot, from_sq, to_sq);
+}
+
 // Generate all moves from position p.  Returns number of moves.
 // strict currently ignored
 int generate_all(position_t * restrict p, sortable_move_t * restrict sortable_move_list,
@@ -142,8 +142,8 @@ typedef struct position {
   uint16_t      ply;              // Even ply are White, odd are Black
   move_t       last_move;        // move that led to this position
   victims_t    victims;          // pieces destroyed by shooter or stomper
-  square_t     kloc[2];          // location of kings
-  square_t     ploc[NUM_PAWNS];
+  uint8_t      kloc[2];          // location of kings (squares fit in a byte)
+  uint8_t      ploc[NUM_PAWNS];  // location of pawns, 0 if captured
 } position_t;
 
 static inline color_t color_to_move_of(position_t *p) {
@@ -246,6 +246,7 @@ int dir_of(int i);
 int reflect_of(int beam_dir, int pawn_ori);
 int beam_of(int direction);
 void move_to_str(move_t mv, char *buf, size_t bufsize);
+move_t str_to_move(position_t *p, const char *mvstring);
 int generate_all(position_t *p, sortable_move_t *sortable_move_list,
                  bool strict);
 int generate_all_opt(position_t *p, sortable_move_t *sortable_move_list,
@@ -0,0 +1,327 @@
+// Copyright (c) 2015 MIT License by 6.172 Staff
+
+// par_for and friends on each of the runtimes, and the parallelism profiler,
+// see parallel.h.
+
+#include "./parallel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if PAR_CILK
+
+// CILK_NWORKERS may ask for more workers than the per-worker arrays hold.
+// Cap it before the runtime starts, and fail fast if it already has.
+static void cilk_check_workers() {
+  static bool checked = false;
+  if (checked) {
+    return;
+  }
+  checked = true;
+  if (__cilkrts_get_nworkers() > PAR_MAX_WORKERS) {
+    char n[16];
+    snprintf(n, sizeof(n), "%d", PAR_MAX_WORKERS);
+    if (__cilkrts_set_param("nworkers", n) != 0 ||
+        __cilkrts_get_nworkers() > PAR_MAX_WORKERS) {
+      fprintf(stderr, "At most %d workers are supported\n", PAR_MAX_WORKERS);
+      exit(1);
+    }
+  }
+}
+
+static void par_for_run(int lo, int hi, par_body_t body, void *ctx,
+                        const volatile bool *cancel) {
+  cilk_check_workers();
+  cilk_for (int i = lo; i < hi; i++) {
+    if (cancel == NULL || !*cancel) {
+      body(ctx, i);
+    }
+  }
+}
+
+void par_begin() {
+  cilk_check_workers();
+}
+
+void par_end() {
+}
+
+int par_set_workers(const char *n) {
+  if (atoi(n) > PAR_MAX_WORKERS) {
+    return 1;
+  }
+  return __cilkrts_set_param("nworkers", n);
+}
+
+int par_num_workers() {
+  return __cilkrts_get_nworkers();
+}
+
+int par_worker_id() {
+  return __cilkrts_get_worker_number();
+}
+
+uint64_t par_steals() {
+  return 0;  // not exposed by the Cilk runtime
+}
+
+#elif PAR_OMP
+
+// OMP_NUM_THREADS may ask for more threads than the per-worker arrays hold;
+// every parallel region is capped at PAR_MAX_WORKERS.
+static int omp_workers() {
+  int workers = omp_get_max_threads();
+  return workers < PAR_MAX_WORKERS ? workers : PAR_MAX_WORKERS;
+}
+
+static void omp_loop(int lo, int hi, par_body_t body, void *ctx,
+                     const volatile bool *cancel) {
+  #pragma omp taskloop grainsize(1)
+  for (int i = lo; i < hi; i++) {
+    if (cancel == NULL || !*cancel) {
+      body(ctx, i);
+    }
+  }
+}
+
+static void par_for_run(int lo, int hi, par_body_t body, void *ctx,
+                        const volatile bool *cancel) {
+  if (omp_in_parallel()) {
+    omp_loop(lo, hi, body, ctx, cancel);
+    return;
+  }
+  #pragma omp parallel num_threads(omp_workers())
+  #pragma omp single
+  omp_loop(lo, hi, body, ctx, cancel);
+}
+
+void par_begin() {
+}
+
+void par_end() {
+}
+
+int par_set_workers(const char *n) {
+  int workers = atoi(n);
+  if (workers < 1 || workers > PAR_MAX_WORKERS) {
+    return 1;
+  }
+  omp_set_num_threads(workers);
+  return 0;
+}
+
+int par_num_workers() {
+  return omp_workers();
+}
+
+int par_worker_id() {
+  return omp_get_thread_num();
+}
+
+uint64_t par_steals() {
+  return 0;  // not exposed by OpenMP
+}
+
+#else
+
+// A range of a par_for, split in halves until single iterations are left.
+// The right halves are spawned and the left one is kept, as cilk_for does.
+typedef struct {
+  int lo;
+  int hi;
+  par_body_t body;
+  void *ctx;
+  const volatile bool *cancel;
+} par_range_t;
+
+static void par_range(void *arg) {
+  par_range_t *r = (par_range_t *) arg;
+  par_range_t halves[32];  // one per halving of an int range
+  par_task_t tasks[32];
+  int spawned = 0;
+  int lo = r->lo;
+  int hi = r->hi;
+  PAR_FRAME(f);
+
+  while (hi - lo > 1) {
+    if (r->cancel != NULL && *r->cancel) {
+      break;
+    }
+    int mid = lo + (hi - lo) / 2;
+    halves[spawned] = *r;
+    halves[spawned].lo = mid;
+    halves[spawned].hi = hi;
+    PAR_SPAWN(f, tasks[spawned], par_range, &halves[spawned]);
+    spawned++;
+    hi = mid;
+  }
+  if (hi - lo == 1 && (r->cancel == NULL || !*r->cancel)) {
+    r->body(r->ctx, lo);
+  }
+  PAR_SYNC(f);
+}
+
+static void par_for_run(int lo, int hi, par_body_t body, void *ctx,
+                        const volatile bool *cancel) {
+  if (hi <= lo) {
+    return;
+  }
+  sched_begin();
+  if (sched_num_workers() == 1) {  // nobody to steal the halves
+    for (int i = lo; i < hi && (cancel == NULL || !*cancel); i++) {
+      body(ctx, i);
+    }
+  } else {
+    par_range_t r = { lo, hi, body, ctx, cancel };
+    par_range(&r);
+  }
+  sched_end();
+}
+
+void par_begin() {
+  sched_begin();
+}
+
+void par_end() {
+  sched_end();
+}
+
+int par_set_workers(const char *n) {
+  return sched_set_workers(atoi(n));
+}
+
+int par_num_workers() {
+  return sched_num_workers();
+}
+
+int par_worker_id() {
+  return sched_worker_id();
+}
+
+uint64_t par_steals() {
+  return sched_steals();
+}
+
+#endif
+
+#if PARPROF
+
+// The profiler follows the work/span model of Cilkscale.  Each strand of the
+// search, from the root or from an iteration of a parallel loop, keeps a
+// frame that accumulates its work and span.  Running serially adds the time
+// to both; a parallel loop adds the sum of its iterations' work to the work
+// and the longest of their spans to the span.  Time spent scheduling, or
+// waiting for steals, is in neither.
+
+typedef struct parprof_frame {
+  uint64_t work;   // ns
+  uint64_t span;   // ns
+  uint64_t start;  // ns, start of the current serial stretch
+} parprof_frame_t;
+
+typedef struct parprof_loop {
+  par_body_t body;
+  void *ctx;
+  parprof_frame_t *parent;  // NULL outside of parprof_begin/parprof_end
+  uint64_t work;
+  uint64_t span;
+} parprof_loop_t;
+
+typedef struct parprof_counters {
+  uint64_t count[PARPROF_NUM_COUNTERS];
+} __attribute__((aligned(64))) parprof_counters_t;
+
+static parprof_counters_t counters[PAR_MAX_WORKERS];
+static parprof_frame_t root;
+static uint64_t root_steals;
+
+// The frame of the strand running on this thread, or NULL.
+static __thread parprof_frame_t *current = NULL;
+
+static uint64_t parprof_now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static void parprof_close(parprof_frame_t *frame) {
+  uint64_t elapsed = parprof_now() - frame->start;
+  frame->work += elapsed;
+  frame->span += elapsed;
+}
+
+void parprof_count(parprof_counter_t counter) {
+  counters[par_worker_id()].count[counter]++;
+}
+
+void parprof_begin() {
+  memset(counters, 0, sizeof(counters));
+  root_steals = par_steals();
+  root.work = 0;
+  root.span = 0;
+  root.start = parprof_now();
+  current = &root;
+}
+
+void parprof_end(parprof_report_t *report) {
+  parprof_close(&root);
+  current = NULL;
+  report->work = root.work / 1e6;
+  report->span = root.span / 1e6;
+  report->steals = par_steals() - root_steals;
+  for (int c = 0; c < PARPROF_NUM_COUNTERS; c++) {
+    report->count[c] = 0;
+    for (int i = 0; i < PAR_MAX_WORKERS; i++) {
+      report->count[c] += counters[i].count[c];
+    }
+  }
+}
+
+static void parprof_iteration(void *arg, int i) {
+  parprof_loop_t *loop = (parprof_loop_t *) arg;
+  if (loop->parent == NULL) {
+    current = NULL;  // not profiling; forget any frame left by an earlier run
+    loop->body(loop->ctx, i);
+    return;
+  }
+
+  parprof_count(PARPROF_ITERATIONS);
+  parprof_frame_t frame = { 0, 0, parprof_now() };
+  current = &frame;
+  loop->body(loop->ctx, i);
+  parprof_close(&frame);
+
+  __sync_fetch_and_add(&loop->work, frame.work);
+  uint64_t span = loop->span;
+  while (frame.span > span &&
+         !__atomic_compare_exchange_n(&loop->span, &span, frame.span, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+void par_for(int lo, int hi, par_body_t body, void *ctx,
+             const volatile bool *cancel) {
+  parprof_loop_t loop = { body, ctx, current, 0, 0 };
+  if (loop.parent != NULL) {
+    parprof_count(PARPROF_LOOPS);
+    parprof_close(loop.parent);
+  }
+  par_for_run(lo, hi, parprof_iteration, &loop, cancel);
+  if (loop.parent != NULL) {
+    loop.parent->work += loop.work;
+    loop.parent->span += loop.span;
+    loop.parent->start = parprof_now();
+  }
+  current = loop.parent;  // this strand may resume on another thread
+}
+
+#else
+
+void par_for(int lo, int hi, par_body_t body, void *ctx,
+             const volatile bool *cancel) {
+  par_for_run(lo, hi, body, ctx, cancel);
+}
+
+#endif
@@ -0,0 +1,97 @@
+// Copyright (c) 2015 MIT License by 6.172 Staff
+
+// The parallel primitives used by the player, on one of three runtimes
+// chosen at build time (RUNTIME= in the Makefile):
+//
+//   native  the work-stealing scheduler in scheduler.c (default)
+//   cilk    Cilk Plus, -DPAR_CILK
+//   omp     OpenMP tasks, -DPAR_OMP
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Worker ids are below this: par_set_workers refuses more workers, and a
+// larger count from CILK_NWORKERS or OMP_NUM_THREADS is capped.
+#define PAR_MAX_WORKERS 256
+
+#if PAR_CILK
+#include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
+#elif PAR_OMP
+#include <omp.h>
+#else
+#include "./scheduler.h"
+#endif
+
+// Body of a parallel loop: runs iteration i.
+typedef void (*par_body_t)(void *ctx, int i);
+
+// Runs body(ctx, i) for lo <= i < hi in parallel and waits for all of them.
+// Once *cancel (if not NULL) becomes true, iterations that have not started
+// are skipped; the ones running are expected to notice it themselves.
+void par_for(int lo, int hi, par_body_t body, void *ctx,
+             const volatile bool *cancel);
+
+// Marks a stretch of work, such as a whole search, during which parallel
+// loops are expected.  The native workers sleep outside of these.
+void par_begin();
+void par_end();
+
+// Sets the number of workers, before any parallel work.  Returns 0 on success.
+int par_set_workers(const char *n);
+int par_num_workers();
+int par_worker_id();
+uint64_t par_steals();  // successful steals so far; 0 if the runtime hides them
+
+// Parallelism profiler, built with PARPROF=1 (make PARPROF=1).  Between
+// parprof_begin and parprof_end on the same thread, it measures the work and
+// span of everything run through par_for, as well as the counters below.
+typedef enum {
+  PARPROF_LOOPS,         // parallel loops run
+  PARPROF_ITERATIONS,    // iterations of those loops
+  PARPROF_CUTOFFS,       // split points cut off by one of their moves
+  PARPROF_ABORTED,       // moves of a split point whose search was cut short
+  PARPROF_WASTED_NODES,  // nodes searched below a split point already cut off
+  PARPROF_NUM_COUNTERS
+} parprof_counter_t;
+
+typedef struct parprof_report {
+  double work;      // milliseconds, summed over all strands
+  double span;      // milliseconds along the critical path
+  uint64_t steals;  // native runtime only
+  uint64_t count[PARPROF_NUM_COUNTERS];
+} parprof_report_t;
+
+#if PARPROF
+void parprof_begin();
+void parprof_end(parprof_report_t *report);
+void parprof_count(parprof_counter_t counter);
+#define PARPROF_COUNT(counter) parprof_count(counter)
+#else
+#define PARPROF_COUNT(counter) ((void) 0)
+#endif
+
+// Spawn and sync of single calls fn(arg).  A function declares PAR_FRAME(f)
+// and a par_task_t for each call it spawns, which must stay alive until
+// PAR_SYNC(f).
+#if PAR_CILK
+typedef int par_task_t;
+#define PAR_FRAME(f)
+#define PAR_SPAWN(f, task, fn, arg) cilk_spawn (fn)(arg)
+#define PAR_SYNC(f) cilk_sync
+#elif PAR_OMP
+typedef int par_task_t;
+#define PAR_FRAME(f)
+#define PAR_SPAWN(f, task, fn, arg) _Pragma("omp task") (fn)(arg)
+#define PAR_SYNC(f) _Pragma("omp taskwait")
+#else
+typedef sched_task_t par_task_t;
+#define PAR_FRAME(f) sched_frame_t f = SCHED_FRAME_INIT
+#define PAR_SPAWN(f, task, fn, arg) sched_spawn(&(f), &(task), (fn), (arg))
+#define PAR_SYNC(f) sched_sync(&(f))
+#endif
+
+#endif  // PARALLEL_H
@@ -0,0 +1,156 @@
+// Copyright (c) 2015 MIT License by 6.172 Staff
+
+// Hardware performance counters and search phase timing, see perfstat.h.
+
+#include "./perfstat.h"
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char *perfstat_event_name[PERFSTAT_NUM_EVENTS] = {
+  "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses",
+  "dtlb_misses"
+};
+
+const char *perfstat_phase_name[PERFSTAT_NUM_PHASES] = {
+  "movegen", "eval", "make_move", "tt"
+};
+
+#ifdef __linux__
+
+#define CACHE_READ_MISS(cache)                                   \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) |              \
+     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct {
+  uint32_t type;
+  uint64_t config;
+} events[PERFSTAT_NUM_EVENTS] = {
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D) },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+  { PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB) },
+};
+
+static int fds[PERFSTAT_NUM_EVENTS] = { -1, -1, -1, -1, -1, -1 };
+
+int perfstat_open() {
+  int opened = 0;
+  int first_errno = 0;
+  for (int e = 0; e < PERFSTAT_NUM_EVENTS; e++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[e].type;
+    attr.config = events[e].config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // With more events than hardware counters the kernel time-shares them.
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fds[e] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fds[e] >= 0) {
+      opened++;
+    } else if (first_errno == 0) {
+      first_errno = errno;
+    }
+  }
+  errno = first_errno;
+  return opened;
+}
+
+void perfstat_close() {
+  for (int e = 0; e < PERFSTAT_NUM_EVENTS; e++) {
+    if (fds[e] >= 0) {
+      close(fds[e]);
+      fds[e] = -1;
+    }
+  }
+}
+
+void perfstat_start() {
+  for (int e = 0; e < PERFSTAT_NUM_EVENTS; e++) {
+    if (fds[e] >= 0) {
+      ioctl(fds[e], PERF_EVENT_IOC_RESET, 0);
+      ioctl(fds[e], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+void perfstat_stop(perfstat_counts_t *counts) {
+  for (int e = 0; e < PERFSTAT_NUM_EVENTS; e++) {
+    if (fds[e] >= 0) {
+      ioctl(fds[e], PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+  for (int e = 0; e < PERFSTAT_NUM_EVENTS; e++) {
+    uint64_t value[3];  // count, time enabled, time running
+    counts->valid[e] = false;
+    counts->count[e] = 0;
+    if (fds[e] < 0 || read(fds[e], value, sizeof(value)) != sizeof(value) ||
+        value[2] == 0) {
+      continue;  // never scheduled on the pmu, so nothing to scale
+    }
+    counts->valid[e] = true;
+    counts->count[e] = value[2] < value[1] ?
+        (uint64_t) ((double) value[0] * value[1] / value[2]) : value[0];
+  }
+}
+
+#else
+
+int perfstat_open() {
+  errno = ENOSYS;
+  return 0;
+}
+
+void perfstat_close() {
+}
+
+void perfstat_start() {
+}
+
+void perfstat_stop(perfstat_counts_t *counts) {
+  memset(counts, 0, sizeof(*counts));
+}
+
+#endif
+
+#if PERFSTAT
+
+perfstat_phase_slot_t perfstat_phase_slots[PAR_MAX_WORKERS];
+
+void perfstat_phases_reset() {
+  memset(perfstat_phase_slots, 0, sizeof(perfstat_phase_slots));
+}
+
+void perfstat_phases_read(perfstat_phases_t *phases) {
+  memset(phases, 0, sizeof(*phases));
+  for (int i = 0; i < PAR_MAX_WORKERS; i++) {
+    for (int p = 0; p < PERFSTAT_NUM_PHASES; p++) {
+      phases->ticks[p] += perfstat_phase_slots[i].phases.ticks[p];
+      phases->calls[p] += perfstat_phase_slots[i].phases.calls[p];
+    }
+  }
+}
+
+#else
+
+void perfstat_phases_reset() {
+}
+
+void perfstat_phases_read(perfstat_phases_t *phases) {
+  memset(phases, 0, sizeof(*phases));
+}
+
+#endif
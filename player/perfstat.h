@@ -0,0 +1,102 @@
+// Copyright (c) 2015 MIT License by 6.172 Staff
+
+// Hardware performance counters of the calling thread, read through Linux's
+// perf_event_open, and, when built with PERFSTAT=1 (make PERFSTAT=1), the
+// time stamp counter ticks spent in each phase of the search.
+
+#ifndef PERFSTAT_H
+#define PERFSTAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "./parallel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+typedef enum {
+  PERFSTAT_CYCLES,
+  PERFSTAT_INSTRUCTIONS,
+  PERFSTAT_L1D_MISSES,     // L1 data cache read misses
+  PERFSTAT_LLC_MISSES,     // last level cache misses
+  PERFSTAT_BRANCH_MISSES,
+  PERFSTAT_DTLB_MISSES,    // data TLB read misses
+  PERFSTAT_NUM_EVENTS
+} perfstat_event_t;
+
+extern const char *perfstat_event_name[PERFSTAT_NUM_EVENTS];
+
+typedef struct perfstat_counts {
+  bool     valid[PERFSTAT_NUM_EVENTS];  // false if the event could not be opened
+  uint64_t count[PERFSTAT_NUM_EVENTS];  // scaled up if the kernel multiplexed it
+} perfstat_counts_t;
+
+// Opens the counters on the calling thread.  They count user space only,
+// which the kernel lets unprivileged processes do unless perf_event_paranoid
+// is above 2.  Events the kernel or the cpu refuses are left out.  Returns
+// the number of events opened; if 0, errno tells why the first one failed.
+int perfstat_open();
+void perfstat_close();
+
+// Counts from perfstat_start to perfstat_stop, on the thread that opened them.
+void perfstat_start();
+void perfstat_stop(perfstat_counts_t *counts);
+
+// Phases of the search, timed by scopes around their calls.
+typedef enum {
+  PERFSTAT_MOVEGEN,    // generate_all_opt
+  PERFSTAT_EVAL,       // eval
+  PERFSTAT_MAKE_MOVE,  // make_move
+  PERFSTAT_TT,         // transposition table probes and stores
+  PERFSTAT_NUM_PHASES
+} perfstat_phase_t;
+
+extern const char *perfstat_phase_name[PERFSTAT_NUM_PHASES];
+
+typedef struct perfstat_phases {
+  uint64_t ticks[PERFSTAT_NUM_PHASES];
+  uint64_t calls[PERFSTAT_NUM_PHASES];
+} perfstat_phases_t;
+
+// Time stamp counter, or nanoseconds where there is none.
+static inline uint64_t perfstat_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+#endif
+}
+
+#if PERFSTAT
+typedef struct perfstat_phase_slot {
+  perfstat_phases_t phases;
+} __attribute__((aligned(64))) perfstat_phase_slot_t;
+
+extern perfstat_phase_slot_t perfstat_phase_slots[PAR_MAX_WORKERS];
+
+static inline void perfstat_phase_add(perfstat_phase_t phase, uint64_t ticks) {
+  perfstat_phases_t *phases = &perfstat_phase_slots[par_worker_id()].phases;
+  phases->ticks[phase] += ticks;
+  phases->calls[phase]++;
+}
+
+// PERFSTAT_SCOPE_BEGIN(s); <calls of the phase>; PERFSTAT_SCOPE_END(s, phase);
+#define PERFSTAT_SCOPE_BEGIN(scope) uint64_t scope = perfstat_ticks()
+#define PERFSTAT_SCOPE_END(scope, phase) \
+    perfstat_phase_add((phase), perfstat_ticks() - (scope))
+#else
+#define PERFSTAT_SCOPE_BEGIN(scope) ((void) 0)
+#define PERFSTAT_SCOPE_END(scope, phase) ((void) 0)
+#endif
+
+// Sums the phases over all workers; all zero unless built with PERFSTAT=1.
+void perfstat_phases_reset();
+void perfstat_phases_read(perfstat_phases_t *phases);
+
+#endif  // PERFSTAT_H
@@ -0,0 +1,269 @@
+// Copyright (c) 2015 MIT License by 6.172 Staff
+
+// Work-stealing scheduler, see scheduler.h.
+//
+// The deques follow Chase and Lev, "Dynamic Circular Work-Stealing Deque"
+// (SPAA 2005), with the memory orderings of Le et al., "Correct and
+// Efficient Work-Stealing for Weak Memory Models" (PPoPP 2013), but with a
+// fixed size: a spawn that finds its deque full runs the task at once.
+
+#include "./scheduler.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <xmmintrin.h>
+
+#define CACHE_LINE 64
+#define SPINS_BEFORE_YIELD 64
+
+typedef struct worker {
+  // The owner's end and the thieves' end are on separate cache lines.
+  int64_t bottom __attribute__((aligned(CACHE_LINE)));
+  int64_t top __attribute__((aligned(CACHE_LINE)));
+  int id __attribute__((aligned(CACHE_LINE)));
+  uint64_t rng;
+  uint64_t steals;
+  pthread_t thread;
+  sched_task_t *tasks[SCHED_DEQUE_SIZE] __attribute__((aligned(CACHE_LINE)));
+} worker_t;
+
+static worker_t *workers = NULL;
+static int num_workers = 0;  // 0: not set, decided by sched_init
+static bool started = false;
+
+static __thread worker_t *self = NULL;
+static int region_depth = 0;  // sched_begin nesting, on worker 0
+
+// Workers sleep on wake while active is 0.
+static int active = 0;
+static pthread_mutex_t sleep_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+
+// -----------------------------------------------------------------------------
+// Deque
+// -----------------------------------------------------------------------------
+
+static bool deque_push(worker_t *w, sched_task_t *task) {
+  int64_t b = __atomic_load_n(&w->bottom, __ATOMIC_RELAXED);
+  int64_t t = __atomic_load_n(&w->top, __ATOMIC_ACQUIRE);
+  if (b - t >= SCHED_DEQUE_SIZE) {
+    return false;
+  }
+  __atomic_store_n(&w->tasks[b & (SCHED_DEQUE_SIZE - 1)], task, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+  return true;
+}
+
+static sched_task_t *deque_pop(worker_t *w) {
+  int64_t b = __atomic_load_n(&w->bottom, __ATOMIC_RELAXED) - 1;
+  __atomic_store_n(&w->bottom, b, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  int64_t t = __atomic_load_n(&w->top, __ATOMIC_RELAXED);
+
+  if (t > b) {  // empty
+    __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+  sched_task_t *task = __atomic_load_n(&w->tasks[b & (SCHED_DEQUE_SIZE - 1)],
+                                       __ATOMIC_RELAXED);
+  if (t == b) {  // the last one: race the thieves for it
+    if (!__atomic_compare_exchange_n(&w->top, &t, t + 1, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+      task = NULL;
+    }
+    __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+  }
+  return task;
+}
+
+static sched_task_t *deque_steal(worker_t *w) {
+  int64_t t = __atomic_load_n(&w->top, __ATOMIC_ACQUIRE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  int64_t b = __atomic_load_n(&w->bottom, __ATOMIC_ACQUIRE);
+
+  if (t >= b) {
+    return NULL;
+  }
+  sched_task_t *task = __atomic_load_n(&w->tasks[t & (SCHED_DEQUE_SIZE - 1)],
+                                       __ATOMIC_RELAXED);
+  if (!__atomic_compare_exchange_n(&w->top, &t, t + 1, false,
+                                   __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+    return NULL;  // lost the race
+  }
+  return task;
+}
+
+// -----------------------------------------------------------------------------
+// Workers
+// -----------------------------------------------------------------------------
+
+static uint64_t next_random(worker_t *w) {
+  w->rng ^= w->rng << 13;
+  w->rng ^= w->rng >> 7;
+  w->rng ^= w->rng << 17;
+  return w->rng;
+}
+
+// Tries every other worker once, starting from a random one.
+static sched_task_t *steal_any(worker_t *w) {
+  int start = next_random(w) % num_workers;
+  for (int i = 0; i < num_workers; i++) {
+    worker_t *victim = &workers[(start + i) % num_workers];
+    if (victim == w) {
+      continue;
+    }
+    sched_task_t *task = deque_steal(victim);
+    if (task != NULL) {
+      w->steals++;
+      return task;
+    }
+  }
+  return NULL;
+}
+
+static void run_task(sched_task_t *task) {
+  // The task lives in the spawning frame, which may return as soon as
+  // pending drops, so it is not touched after that.
+  sched_frame_t *frame = task->frame;
+  task->fn(task->arg);
+  __atomic_fetch_sub(&frame->pending, 1, __ATOMIC_RELEASE);
+}
+
+static void *worker_main(void *arg) {
+  self = (worker_t *) arg;
+  int fails = 0;
+  while (true) {
+    if (__atomic_load_n(&active, __ATOMIC_ACQUIRE) == 0) {
+      pthread_mutex_lock(&sleep_mutex);
+      while (active == 0) {
+        pthread_cond_wait(&wake, &sleep_mutex);
+      }
+      pthread_mutex_unlock(&sleep_mutex);
+    }
+
+    sched_task_t *task = steal_any(self);
+    if (task != NULL) {
+      run_task(task);
+      fails = 0;
+    } else if (++fails >= SPINS_BEFORE_YIELD) {
+      sched_yield();
+      fails = 0;
+    } else {
+      _mm_pause();
+    }
+  }
+  return NULL;
+}
+
+int sched_set_workers(int n) {
+  if (started || n < 1 || n > SCHED_MAX_WORKERS) {
+    return 1;
+  }
+  num_workers = n;
+  return 0;
+}
+
+void sched_init() {
+  if (started) {
+    return;
+  }
+  if (num_workers == 0) {
+    // CILK_NWORKERS is honored so that existing test setups keep working.
+    char *env = getenv("CILK_NWORKERS");
+    num_workers = (env != NULL) ? atoi(env) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_workers < 1) {
+      num_workers = 1;
+    }
+    if (num_workers > SCHED_MAX_WORKERS) {
+      num_workers = SCHED_MAX_WORKERS;
+    }
+  }
+
+  if (posix_memalign((void **) &workers, CACHE_LINE,
+                     sizeof(worker_t) * num_workers) != 0) {
+    fprintf(stderr, "Out of memory for %d workers\n", num_workers);
+    exit(1);
+  }
+  memset(workers, 0, sizeof(worker_t) * num_workers);
+  for (int i = 0; i < num_workers; i++) {
+    workers[i].id = i;
+    workers[i].rng = 0x9e3779b97f4a7c15ULL * (i + 1);
+  }
+  self = &workers[0];
+  started = true;
+
+  for (int i = 1; i < num_workers; i++) {
+    pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+  }
+}
+
+void sched_begin() {
+  if (!started) {
+    sched_init();
+  }
+  if (self != &workers[0] || region_depth++ > 0) {
+    return;
+  }
+  pthread_mutex_lock(&sleep_mutex);
+  __atomic_store_n(&active, 1, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&wake);
+  pthread_mutex_unlock(&sleep_mutex);
+}
+
+void sched_end() {
+  if (self != &workers[0] || --region_depth > 0) {
+    return;
+  }
+  __atomic_store_n(&active, 0, __ATOMIC_RELEASE);
+}
+
+void sched_spawn(sched_frame_t *frame, sched_task_t *task,
+                 void (*fn)(void *arg), void *arg) {
+  task->fn = fn;
+  task->arg = arg;
+  task->frame = frame;
+  __atomic_fetch_add(&frame->pending, 1, __ATOMIC_RELAXED);
+  if (self == NULL || !deque_push(self, task)) {
+    run_task(task);
+  }
+}
+
+void sched_sync(sched_frame_t *frame) {
+  int fails = 0;
+  while (__atomic_load_n(&frame->pending, __ATOMIC_ACQUIRE) > 0) {
+    sched_task_t *task = deque_pop(self);
+    if (task == NULL) {
+      task = steal_any(self);
+    }
+    if (task != NULL) {
+      run_task(task);
+      fails = 0;
+    } else if (++fails >= SPINS_BEFORE_YIELD) {
+      sched_yield();
+      fails = 0;
+    } else {
+      _mm_pause();
+    }
+  }
+}
+
+int sched_num_workers() {
+  return started ? num_workers : 1;
+}
+
+int sched_worker_id() {
+  return (self != NULL) ? self->id : 0;
+}
+
+uint64_t sched_steals() {
+  uint64_t steals = 0;
+  for (int i = 0; i < (started ? num_workers : 0); i++) {
+    steals += __atomic_load_n(&workers[i].steals, __ATOMIC_RELAXED);
+  }
+  return steals;
+}
@@ -0,0 +1,59 @@
+// Copyright (c) 2015 MIT License by 6.172 Staff
+
+// A small work-stealing scheduler: one thread per worker, each with a
+// Chase-Lev deque of spawned tasks.  A worker pushes and pops tasks at the
+// bottom of its own deque; idle workers steal from the top of others'.
+//
+// The search does not use this directly but through parallel.h, which can
+// also map onto Cilk or OpenMP.
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SCHED_MAX_WORKERS 256
+#define SCHED_DEQUE_SIZE 4096  // must be a power of 2
+
+// A spawned call fn(arg).  Owned by the spawning frame until it syncs.
+typedef struct sched_task {
+  void (*fn)(void *arg);
+  void *arg;
+  struct sched_frame *frame;
+} sched_task_t;
+
+// The spawns of one function, waited for by sched_sync.
+typedef struct sched_frame {
+  int pending;  // spawned tasks not yet finished
+} sched_frame_t;
+
+#define SCHED_FRAME_INIT { 0 }
+
+// Sets the number of workers; only before the scheduler has started.
+// Returns 0 on success.
+int sched_set_workers(int n);
+
+// Starts the workers.  The calling thread becomes worker 0.  Called lazily
+// by sched_begin.
+void sched_init();
+
+// The workers steal only between sched_begin and sched_end, and sleep
+// otherwise.  Calls nest; sched_begin starts the scheduler if needed.
+void sched_begin();
+void sched_end();
+
+// Runs task->fn(arg) on this or another worker.  Must be called on a
+// worker, between sched_begin and sched_end.
+void sched_spawn(sched_frame_t *frame, sched_task_t *task,
+                 void (*fn)(void *arg), void *arg);
+
+// Waits for all the tasks spawned in frame, running other work meanwhile.
+void sched_sync(sched_frame_t *frame);
+
+int sched_num_workers();
+int sched_worker_id();     // 0 outside the workers
+
+uint64_t sched_steals();   // total successful steals so far
+
+#endif  // SCHEDULER_H
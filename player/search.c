@@ -15,6 +15,7 @@ implementation has been provided for you.
 
 #include "./search.h"
 
+#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -22,8 +23,7 @@ implementation has been provided for you.
 #include <stdbool.h>
 #include <string.h>
 #include <pthread.h>
-#include <cilk/cilk.h>
-#include <cilk/reducer.h>
+#include <time.h>
 
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
@@ -32,15 +32,11 @@ implementation has been provided for you.
 #include "./tt.h"
 #include "./util.h"
 #include "./fen.h"
+#include "./parallel.h"
+#include "./perfstat.h"
 #include "./tbassert.h"
 
 
-// -----------------------------------------------------------------------------
-// Preprocessor
-// -----------------------------------------------------------------------------
-
-#define ABORT_CHECK_PERIOD 0xfff
-
 // -----------------------------------------------------------------------------
 // READ ONLY settings (see iopt in leiserchess.c)
 // -----------------------------------------------------------------------------
@@ -62,12 +58,17 @@ int DETECT_DRAWS;  // Detect draws by repetition
 // do not set more than 5 ply
 int FUT_DEPTH;     // set to zero for no futilty
 
+int MULTIPV;       // Number of root moves to report with exact scores
+
+int PV_SPLIT;      // Search the moves of PV nodes after the first in parallel
+int SERIAL_DEPTH;  // Nodes of lower depth search all their moves serially
+
 
 // Declare the two main search functions.
 static score_t searchPV(searchNode *node, int depth,
-                        uint64_t *node_count_serial);
+                        nodeCounter *node_count_serial);
 static score_t scout_search(searchNode *node, int depth,
-                            uint64_t *node_count_serial);
+                            nodeCounter *node_count_serial);
 
 // Include common search functions
 #include "./search_globals.c"
@@ -78,13 +79,15 @@ static score_t scout_search(searchNode *node, int depth,
 //   https://chessprogramming.wikispaces.com/Node+Types#PV
 static void initialize_pv_node(searchNode* node, int depth) {
   node->type = SEARCH_PV;
+  node->state = node->parent->state;
   node->alpha = -node->parent->beta;
   node->orig_alpha = node->alpha;  // Save original alpha.
   node->beta = -node->parent->alpha;
-  node->subpv[0] = 0;
+  node->best_move = 0;
   node->depth = depth;
   node->legal_move_count = 0;
   node->ply = node->parent->ply + 1;
+  node->pv[node->ply][0] = 0;
   node->fake_color_to_move = color_to_move_of(&(node->position));
   // point of view = 1 for white, -1 for black
   node->pov = 1 - node->fake_color_to_move * 2;
@@ -92,11 +95,108 @@ static void initialize_pv_node(searchNode* node, int depth) {
   node->best_move_index = 0;
   node->best_score = -INF;
   node->abort = false;
+  node->token = node->parent->child_token;
+  node->child_token = node->token;
+}
+
+// The moves of a PV node after the first, which are searched in parallel
+// once the first one has raised alpha.  Each move is scouted against the
+// alpha of the moment and re-searched as a PV node if it fails high; the
+// scores are merged into the node under node_mutex.
+typedef struct pvLoop {
+  searchNode *node;
+  sortable_move_t *move_list;
+  int *number_of_moves_evaluated;
+  abortToken *token;  // of this split point
+  simple_mutex_t *node_mutex;
+  move_t killer_a;
+  move_t killer_b;
+  nodeCounter *node_count_serial;
+} pvLoop;
+
+// Merges the result of a move into the node, as the serial loop does.
+static void pv_publish_score(pvLoop *loop, move_t mv, int index,
+                             moveEvaluationResult *result, move_t *child_pv) {
+  searchNode *node = loop->node;
+  bool cutoff = false;
+  simple_acquire(loop->node_mutex);
+  if (!node->abort) {
+    cutoff = search_process_score(node, mv, index, result, SEARCH_PV, child_pv);
+    node->abort = cutoff;
+  }
+  simple_release(loop->node_mutex);
+  if (cutoff) {
+    PARPROF_COUNT(PARPROF_CUTOFFS);
+    abort_token_cancel(loop->token);
+  }
+}
+
+// Re-searches a move whose scout failed high.  The moves below a split point
+// are searched concurrently, so the PV of the re-search goes to a table of
+// its own; this is kept out of pv_search_move so that only re-searches pay
+// for it.
+static __attribute__((noinline)) void pv_research_move(pvLoop *loop, move_t mv,
+                                                       int index,
+                                                       moveEvaluationResult *result) {
+  searchNode *node = loop->node;
+  move_t pv[MAX_PLY_IN_SEARCH][MAX_PLY_IN_SEARCH];
+  result->next_node.pv = pv;
+  result->score = -searchPV(&(result->next_node), result->research_depth,
+                            loop->node_count_serial);
+  if (loop->token->aborted) {  // cut off meanwhile, here or above
+    PARPROF_COUNT(PARPROF_ABORTED);
+    return;
+  }
+  if (abortf) {
+    return;
+  }
+  pv_publish_score(loop, mv, index, result, pv[node->ply + 1]);
+}
+
+// Searches the next unclaimed move of a PV node; one parallel iteration.
+static void pv_search_move(void *ctx, int mv_index) {
+  pvLoop *loop = (pvLoop *) ctx;
+  searchNode *node = loop->node;
+
+  if (node->abort) return;
+
+  int local_index = __sync_fetch_and_add(loop->number_of_moves_evaluated, 1);
+  move_t mv = get_move(loop->move_list[local_index]);
+
+  count_node(loop->node_count_serial, node);
+
+  moveEvaluationResult result;
+  evaluateMove(node, mv, loop->killer_a, loop->killer_b,
+               SEARCH_PV,
+               loop->node_count_serial,
+               &result);
+
+  if (loop->token->aborted) {  // cut off meanwhile, here or above
+    PARPROF_COUNT(PARPROF_ABORTED);
+    return;
+  }
+
+  if (result.type == MOVE_ILLEGAL || result.type == MOVE_IGNORE
+      || abortf || parallel_parent_aborted(node)) {
+    return;
+  }
+
+  if (result.type != MOVE_GAMEOVER) {
+    __sync_fetch_and_add(&node->legal_move_count, 1);
+  }
+
+  // Alpha may have risen past the scout score since, in which case the move
+  // is already refuted.
+  if (result.type == MOVE_RESEARCH && result.score > node->alpha) {
+    pv_research_move(loop, mv, local_index, &result);
+    return;
+  }
+  pv_publish_score(loop, mv, local_index, &result, NULL);
 }
 
 // Perform a Principle Variation Search
 //   https://chessprogramming.wikispaces.com/Principal+Variation+Search
-static score_t searchPV(searchNode *node, int depth, uint64_t *node_count_serial) {
+static score_t searchPV(searchNode *node, int depth, nodeCounter *node_count_serial) {
   // Initialize the searchNode data structure.
   initialize_pv_node(node, depth);
 
@@ -117,8 +217,8 @@ static score_t searchPV(searchNode *node, int depth, uint64_t *node_count_serial
   }
 
   // Get the killer moves at this node.
-  move_t killer_a = killer[KMT(node->ply, 0)];
-  move_t killer_b = killer[KMT(node->ply, 1)];
+  move_t killer_a = node->state->killer[KMT(node->ply, 0)];
+  move_t killer_b = node->state->killer[KMT(node->ply, 1)];
 
 
   // sortable_move_t move_list
@@ -141,16 +241,25 @@ static score_t searchPV(searchNode *node, int depth, uint64_t *node_count_serial
   sortable_move_t move_list[MAX_NUM_MOVES];
   int num_of_moves = get_sortable_move_list(node, move_list, hash_table_move);
   int num_moves_tried = 0;
+  bool cutoff = false;
+
+  // Start searching moves.  With PV_SPLIT, the moves after the first legal
+  // one are left to the parallel loop below.
+  bool split = PV_SPLIT && !node->quiescence && depth >= SERIAL_DEPTH &&
+               !node->state->serial;
+  int mv_index;
+  for (mv_index = 0; mv_index < num_of_moves; mv_index++) {
+    if (split && node->legal_move_count > 0) {
+      break;
+    }
 
-  // Start searching moves.
-  for (int mv_index = 0; mv_index < num_of_moves; mv_index++) {
     // Incrementally sort the move list.
     sort_incremental(move_list, num_of_moves, mv_index);
 
     move_t mv = get_move(move_list[mv_index]);
 
     num_moves_tried++;
-    (*node_count_serial)++;
+    count_node(node_count_serial, node);
 
     moveEvaluationResult result;
     evaluateMove(node, mv, killer_a, killer_b,
@@ -169,18 +278,41 @@ static score_t searchPV(searchNode *node, int depth, uint64_t *node_count_serial
     }
 
     // Check if we should abort due to time control.
-    if (abortf) {
+    if (abortf || parallel_parent_aborted(node)) {
       return 0;
     }
 
-    bool cutoff = search_process_score(node, mv, mv_index, &result, SEARCH_PV);
+    cutoff = search_process_score(node, mv, mv_index, &result, SEARCH_PV,
+                                  node->pv[node->ply + 1]);
     if (cutoff) {
       break;
     }
   }
 
+  if (!cutoff && mv_index < num_of_moves) {
+    sort_tail(move_list, mv_index, num_of_moves);
+    simple_mutex_t node_mutex;
+    init_simple_mutex(&node_mutex);
+    abortToken token;
+    abort_token_register(&token, node->token);
+    node->child_token = &token;
+    int number_of_moves_evaluated = mv_index;
+    pvLoop loop = {
+      node, move_list, &number_of_moves_evaluated, &token, &node_mutex,
+      killer_a, killer_b, node_count_serial
+    };
+    par_for(mv_index, num_of_moves, pv_search_move, &loop, &node->abort);
+    abort_token_unregister(&token);
+    node->child_token = node->token;
+    num_moves_tried = number_of_moves_evaluated;
+
+    if (abortf || parallel_parent_aborted(node)) {
+      return 0;
+    }
+  }
+
   if (node->quiescence == false) {
-    update_best_move_history(&(node->position), node->best_move_index,
+    update_best_move_history(node, node->best_move_index,
                              move_list, num_moves_tried);
   }
 
@@ -191,7 +323,7 @@ static score_t searchPV(searchNode *node, int depth, uint64_t *node_count_serial
   //
   // Note: This function reads node->best_score, node->orig_alpha,
   //   node->position.key, node->depth, node->ply, node->beta,
-  //   node->alpha, node->subpv
+  //   node->alpha, node->best_move
   update_transposition_table(node);
 
   return node->best_score;
@@ -203,8 +335,10 @@ static score_t searchPV(searchNode *node, int depth, uint64_t *node_count_serial
 // This handles scout search logic for the first level of the search tree
 // -----------------------------------------------------------------------------
 static void initialize_root_node(searchNode *node, score_t alpha, score_t beta, int depth,
-                            int ply, position_t* p) {
+                            int ply, position_t* p, searchState *state,
+                            abortToken *token) {
   node->type = SEARCH_ROOT;
+  node->state = state;
   node->alpha = alpha;
   node->beta = beta;
   node->depth = depth;
@@ -214,48 +348,109 @@ static void initialize_root_node(searchNode *node, score_t alpha, score_t beta,
   node->best_score = -INF;
   node->pov = 1 - node->fake_color_to_move * 2;  // pov = 1 for White, -1 for Black
   node->abort = false;
+  node->token = token;
+  node->child_token = token;
+}
+
+// A root move kept in multi-PV mode, together with its exact score and PV.
+typedef struct rootLine {
+  score_t score;
+  move_t  pv[MAX_PLY_IN_SEARCH];
+} rootLine;
+
+// Inserts mv into lines[], which is kept sorted by decreasing score and holds
+// at most max_lines entries.  Returns the rank at which mv was inserted.
+static int insert_root_line(rootLine *lines, int *num_lines, int max_lines,
+                            move_t mv, score_t score, move_t *subpv) {
+  int rank = (*num_lines < max_lines) ? (*num_lines)++ : max_lines - 1;
+  while (rank > 0 && lines[rank - 1].score < score) {
+    lines[rank] = lines[rank - 1];
+    rank--;
+  }
+  lines[rank].score = score;
+  lines[rank].pv[0] = mv;
+  copy_pv(lines[rank].pv + 1, subpv, MAX_PLY_IN_SEARCH - 1);
+  return rank;
+}
+
+// Prints all k lines together, as the UCI multipv convention requires.
+static void print_root_lines(rootLine *lines, int num_lines, int depth,
+                             FILE *OUT) {
+  char pvbuf[MAX_PLY_IN_SEARCH * MAX_CHARS_IN_MOVE];
+  for (int i = 0; i < num_lines; i++) {
+    getPV(lines[i].pv, pvbuf, MAX_PLY_IN_SEARCH * MAX_CHARS_IN_MOVE);
+    fprintf(OUT, "info multipv %d depth %d score cp %d pv %s\n",
+            i + 1, depth, lines[i].score, pvbuf);
+  }
 }
 
 score_t searchRoot(position_t *p, score_t alpha, score_t beta, int depth,
-                   int ply, move_t *pv, uint64_t *node_count_serial,
-                   FILE *OUT) {
-  static int num_of_moves = 0;  // number of moves in list
-  // hopefully, more than we will need
-  static sortable_move_t move_list[MAX_NUM_MOVES];
+                   int ply, move_t *pv, nodeCounter *node_count_serial,
+                   FILE *OUT, searchState *state) {
+  // The root move list is kept across iterations, so it lives in the state.
+  sortable_move_t *move_list = state->root_move_list;
 
   if (depth == 1) {
     // we are at depth 1; generate all possible moves
-    num_of_moves = generate_all_opt(p, move_list, false);
+    state->root_num_of_moves = generate_all_opt(p, move_list, false);
+  }
+  int num_of_moves = state->root_num_of_moves;  // number of moves in list
+
+  if (depth == 1) {
     // shuffle the list of moves
     for (int i = 0; i < num_of_moves; i++) {
-      int r = myrand() % num_of_moves;
+      int r = myrand_r(&state->rng) % num_of_moves;
       sortable_move_t tmp = move_list[i];
       move_list[i] = move_list[r];
       move_list[r] = tmp;
     }
   }
 
+  // The root is never cut off; split points below register with this.
+  abortToken root_token = { false, 0, NULL, NULL, NULL, NULL };
+
   searchNode rootNode;
   rootNode.parent = NULL;
-  initialize_root_node(&rootNode, alpha, beta, depth, ply, p);
+  initialize_root_node(&rootNode, alpha, beta, depth, ply, p, state,
+                       &root_token);
 
 
   assert(rootNode.best_score == alpha);  // initial conditions
 
+  rootNode.pv = state->pv;
+
   searchNode next_node;
-  next_node.subpv[0] = 0;
   next_node.parent = &rootNode;
+  next_node.pv = state->pv;
+  // the PV of the move being searched, as left by searchPV
+  move_t *subpv = state->pv[ply + 1];
+
+  // The best MULTIPV root moves found so far in this iteration.  With a
+  // single PV this is just the best move.
+  int multipv = MULTIPV < MAX_MULTIPV ? MULTIPV : MAX_MULTIPV;
+  rootLine lines[MAX_MULTIPV];
+  int num_lines = 0;
 
   score_t score;
 
   for (int mv_index = 0; mv_index < num_of_moves; mv_index++) {
     move_t mv = get_move(move_list[mv_index]);
 
+    // Until every line is filled, any move needs an exact score.  After
+    // that, a move only matters if it beats the weakest line, so that score
+    // is the alpha the scout (and any PV re-search) is run against.
+    if (num_lines == multipv && lines[multipv - 1].score > alpha) {
+      rootNode.alpha = lines[multipv - 1].score;
+    } else {
+      rootNode.alpha = alpha;
+    }
+
     if (TRACE_MOVES) {
       print_move_info(mv, ply);
     }
 
-    (*node_count_serial)++;
+    count_node(node_count_serial, &rootNode);
+    subpv[0] = 0;
 
     // make the move.
     victims_t x = make_move(&(rootNode.position), &(next_node.position), mv);
@@ -266,18 +461,16 @@ score_t searchRoot(position_t *p, score_t alpha, score_t beta, int depth,
 
     if (is_game_over(x, rootNode.pov, rootNode.ply)) {
       score = get_game_over_score(x, rootNode.pov, rootNode.ply);
-      next_node.subpv[0] = 0;
       goto scored;
     }
 
     if (is_repeated(&(next_node.position), rootNode.ply)) {
       score = get_draw_score(&(next_node.position), rootNode.ply);
-      next_node.subpv[0] = 0;
       goto scored;
     }
 
-    if (mv_index == 0 || rootNode.depth == 1) {
-      // We guess that the first move is the principle variation
+    if (mv_index < multipv || rootNode.depth == 1) {
+      // We guess that the first moves are the principle variations
       score = -searchPV(&next_node, rootNode.depth-1, node_count_serial);
 
       // Check if we should abort due to time control.
@@ -304,44 +497,52 @@ score_t searchRoot(position_t *p, score_t alpha, score_t beta, int depth,
 
   scored:
     // only valid for the root node:
-    tbassert((score > rootNode.best_score) == (score > rootNode.alpha),
+    tbassert(multipv > 1 ||
+             (score > rootNode.best_score) == (score > rootNode.alpha),
              "score = %d, best = %d, alpha = %d\n", score, rootNode.best_score, rootNode.alpha);
 
-    if (score > rootNode.best_score) {
-      tbassert(score > rootNode.alpha, "score: %d, alpha: %d\n", score, rootNode.alpha);
-
-      rootNode.best_score = score;
-      pv[0] = mv;
-      memcpy(pv+1, next_node.subpv, sizeof(move_t) * (MAX_PLY_IN_SEARCH - 1));
-      pv[MAX_PLY_IN_SEARCH - 1] = 0;
-
-      // Print out based on UCI (universal chess interface)
-      double et = elapsed_time();
-      char   pvbuf[MAX_PLY_IN_SEARCH * MAX_CHARS_IN_MOVE];
-      getPV(pv, pvbuf, MAX_PLY_IN_SEARCH * MAX_CHARS_IN_MOVE);
-      if (et < 0.00001) {
-        et = 0.00001;  // hack so that we don't divide by 0
+    if (score > rootNode.alpha) {
+      int rank = insert_root_line(lines, &num_lines, multipv, mv, score,
+                                  subpv);
+
+      if (rank == 0) {
+        tbassert(score > rootNode.best_score, "score: %d, best: %d\n",
+                 score, rootNode.best_score);
+
+        rootNode.best_score = score;
+        copy_pv(pv, lines[0].pv, MAX_PLY_IN_SEARCH);
+
+        // Print out based on UCI (universal chess interface)
+        if (OUT != NULL) {
+          double et = elapsed_time();
+          char   pvbuf[MAX_PLY_IN_SEARCH * MAX_CHARS_IN_MOVE];
+          getPV(pv, pvbuf, MAX_PLY_IN_SEARCH * MAX_CHARS_IN_MOVE);
+          if (et < 0.00001) {
+            et = 0.00001;  // hack so that we don't divide by 0
+          }
+
+          uint64_t nodes = node_counter_total(node_count_serial);
+          uint64_t nps = 1000 * nodes / et;
+          fprintf(OUT, "info depth %d move_no %d time (microsec) %d nodes %" PRIu64
+                  " nps %" PRIu64 "\n",
+                  depth, mv_index + 1, (int) (et * 1000), nodes, nps);
+          fprintf(OUT, "info score cp %d pv %s\n", score, pvbuf);
+        }
       }
 
-      uint64_t nps = 1000 * *node_count_serial / et;
-      fprintf(OUT, "info depth %d move_no %d time (microsec) %d nodes %" PRIu64
-              " nps %" PRIu64 "\n",
-              depth, mv_index + 1, (int) (et * 1000), *node_count_serial, nps);
-      fprintf(OUT, "info score cp %d pv %s\n", score, pvbuf);
+      if (multipv > 1 && OUT != NULL) {
+        print_root_lines(lines, num_lines, depth, OUT);
+      }
 
-      // Slide this move to the front of the move list
-      for (int j = mv_index; j > 0; j--) {
+      // Slide this move into its rank in the move list, so that the next
+      // iteration searches the previous lines first and in order.
+      for (int j = mv_index; j > rank; j--) {
         move_list[j] = move_list[j - 1];
       }
-      move_list[0] = mv;
+      move_list[rank] = mv;
     }
 
-    // Normal alpha-beta logic: if the current score is better than what the
-    // maximizer has been able to get so far, take that new value.  Likewise,
     // score >= beta is the beta cutoff condition
-    if (score > rootNode.alpha) {
-      rootNode.alpha = score;
-    }
     if (score >= rootNode.beta) {
       tbassert(0, "score: %d, beta: %d\n", score, rootNode.beta);
       break;
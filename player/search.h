@@ -5,6 +5,7 @@
 
 #include <stdio.h>
 #include "./move_gen.h"
+#include "./parallel.h"
 
 // score_t values
 #define INF 32700
@@ -17,6 +18,9 @@
 // the maximum possible value for score_t type
 #define MAX_SCORE_VAL INT16_MAX
 
+// the maximum number of root moves reported in multi-PV mode
+#define MAX_MULTIPV 16
+
 
 /*//// Killer moves table and lookup function
 //
@@ -43,36 +47,87 @@ typedef enum searchType {  // different types of search
   SEARCH_SCOUT
 } searchType_t;
 
+// State owned by a single search: the move-ordering tables and the root move
+// list that persists across iterative-deepening iterations.  Searches that
+// run concurrently (e.g., in batch mode) each need their own.
+typedef struct searchState {
+  move_t killer[MAX_PLY_IN_SEARCH * 4];  // up to 4 killers per ply
+  // Format: best_move_history[color_t][piece_t][square_t][orientation]
+  int best_move_history[2 * 6 * ARR_SIZE * NUM_ORI];
+  sortable_move_t root_move_list[MAX_NUM_MOVES];
+  int root_num_of_moves;
+  bool serial;  // search the whole tree on the calling worker
+  uint64_t rng;  // myrand_r state of the root move shuffle; set it to seed
+  // Triangular PV table: pv[ply] holds the PV of the PV node being searched
+  // at that ply, terminated by 0.  PV nodes are searched one at a time along
+  // the principal variation, so one row per ply suffices; scout nodes only
+  // record their best move.  The PV re-searches that run in parallel below
+  // a split PV node each use a table of their own (see searchNode::pv).
+  move_t pv[MAX_PLY_IN_SEARCH][MAX_PLY_IN_SEARCH];
+} searchState;
+
+// Nodes searched by a search, counted by each worker in a slot on a cache
+// line of its own, so that the workers never write to a shared line.  The
+// slots are summed by node_counter_total when the count is reported.
+typedef struct nodeCountSlot {
+  uint64_t nodes;
+} __attribute__((aligned(64))) nodeCountSlot;
+
+typedef struct nodeCounter {
+  nodeCountSlot worker[PAR_MAX_WORKERS];
+} nodeCounter;
+
+// Cancellation token of a split point, a scout node whose moves are searched
+// in parallel.  It is registered with the token of the nearest split point
+// above it, and cancelling a token cancels every token registered below it,
+// so a node learns that some ancestor cut off by reading one flag.
+typedef struct abortToken {
+  volatile bool aborted;
+  int lock;                     // a simple_mutex_t guarding children
+  struct abortToken *parent;
+  struct abortToken *children;  // tokens of the split points below
+  struct abortToken *prev;      // siblings in parent->children
+  struct abortToken *next;
+} abortToken;
+
+// A node holds only what the search of that node reads and writes; it lives
+// on the stack of every recursion level, so keep it small.
 typedef struct searchNode {
   struct searchNode* parent;
-  searchType_t type;
+  searchState* state;
   score_t orig_alpha;
   score_t alpha;
   score_t beta;
+  score_t best_score;
+  searchType_t type;
   int depth;
   int ply;
   int fake_color_to_move;
   int quiescence;
   int pov;
   int legal_move_count;
-  bool abort;
-  score_t best_score;
   int best_move_index;
+  move_t best_move;
+  bool abort;
+  abortToken *token;        // of the nearest split point above this node
+  abortToken *child_token;  // handed to the children: token, or this node's
+  move_t (*pv)[MAX_PLY_IN_SEARCH];  // PV table of a PV node, set by the caller
   position_t position;
-  move_t subpv[MAX_PLY_IN_SEARCH];
 } searchNode;
 
 
-void init_tics();
 void init_abort_timer(double goal_time);
 double elapsed_time();
 bool should_abort();
 void reset_abort();
-void init_best_move_history();
+void init_search_state(searchState *state);
+void init_best_move_history(searchState *state);
+void node_counter_reset(nodeCounter *counter);
+uint64_t node_counter_total(nodeCounter *counter);
 move_t get_move(sortable_move_t sortable_mv);
 score_t searchRoot(position_t *p, score_t alpha, score_t beta, int depth,
-                   int ply, move_t *pv, uint64_t *node_count_serial,
-                   FILE *OUT);
+                   int ply, move_t *pv, nodeCounter *node_count_serial,
+                   FILE *OUT, searchState *state);
 
 
 #endif  // SEARCH_H
@@ -1,10 +1,16 @@
 // Copyright (c) 2015 MIT License by 6.172 Staff
 
-// tic counter for how often we should check for abort
-static int     tics = 0;
 static double  sstart;    // start time of a search in milliseconds
 static double  timeout;   // time elapsed before abort
-static bool    abortf = false;  // abort flag for search
+static volatile bool abortf = false;  // abort flag for search
+
+// A timer thread sleeps until the deadline set by init_abort_timer and then
+// raises abortf, so the search itself only ever loads the flag.  timer_seq
+// counts the calls to init_abort_timer, which wake the timer to re-arm it.
+static pthread_once_t  timer_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t timer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  timer_cond = PTHREAD_COND_INITIALIZER;
+static uint64_t        timer_seq = 0;
 
 static score_t fmarg[10] = {
   0, PAWN_VALUE / 2, PAWN_VALUE, (PAWN_VALUE * 5) / 2, (PAWN_VALUE * 9) / 2,
@@ -16,12 +22,14 @@ typedef enum {
     MOVE_EVALUATED,
     MOVE_ILLEGAL,
     MOVE_IGNORE,
-    MOVE_GAMEOVER
+    MOVE_GAMEOVER,
+    MOVE_RESEARCH   // scout failed high at a split PV node, see searchPV
 } moveEvaluationResult_t;
 
 typedef struct moveEvaluationResult {
   score_t score;
   moveEvaluationResult_t type;
+  int research_depth;  // for MOVE_RESEARCH
   searchNode next_node;
 } moveEvaluationResult;
 
@@ -51,10 +59,50 @@ static void set_sort_key(sortable_move_t *mv, sort_key_t key) {
   return;
 }
 
+static void *abort_timer(void *arg) {
+  pthread_mutex_lock(&timer_mutex);
+  while (true) {
+    double remaining = timeout - milliseconds();
+    if (remaining <= 0) {
+      abortf = true;
+      uint64_t seq = timer_seq;
+      while (seq == timer_seq) {
+        pthread_cond_wait(&timer_cond, &timer_mutex);
+      }
+      continue;
+    }
+    // Condition variables time out against the wall clock; waking early or
+    // late by a clock adjustment just means another trip around the loop.
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    uint64_t ms = (uint64_t) remaining;
+    long ns = deadline.tv_nsec + (long) ((ms % 1000) * 1000000 +
+                                         (remaining - ms) * 1e6);
+    deadline.tv_sec += ms / 1000 + ns / 1000000000;
+    deadline.tv_nsec = ns % 1000000000;
+    pthread_cond_timedwait(&timer_cond, &timer_mutex, &deadline);
+  }
+  return NULL;
+}
+
+static void start_abort_timer() {
+  pthread_t timer;
+  if (pthread_create(&timer, NULL, abort_timer, NULL) != 0) {
+    fprintf(stderr, "Cannot start the search timer\n");
+    exit(1);
+  }
+  pthread_detach(timer);
+}
+
 void init_abort_timer(double goal_time) {
+  pthread_once(&timer_once, start_abort_timer);
+  pthread_mutex_lock(&timer_mutex);
   sstart = milliseconds();
   // don't go over any more than 3 times the goal
   timeout = sstart + goal_time * 3.0;
+  timer_seq++;
+  pthread_cond_signal(&timer_cond);
+  pthread_mutex_unlock(&timer_mutex);
 }
 
 double elapsed_time() {
@@ -65,12 +113,9 @@ bool should_abort() {
   return abortf;
 }
 
+// Clears the flag for the next iteration, unless the deadline has passed.
 void reset_abort() {
-  abortf = false;
-}
-
-void init_tics() {
-  tics = 0;
+  abortf = (milliseconds() >= timeout);
 }
 
 move_t get_move(sortable_move_t sortable_mv) {
@@ -159,6 +204,16 @@ static score_t get_game_over_score(victims_t victims, int pov, int ply) {
   return score;
 }
 
+// Copies the 0-terminated PV src into dst, writing at most size moves and
+// always terminating dst.
+static void copy_pv(move_t *dst, move_t *src, int size) {
+  int i = 0;
+  for (; i < size - 1 && src[i] != 0; i++) {
+    dst[i] = src[i];
+  }
+  dst[i] = 0;
+}
+
 static void getPV(move_t *pv, char *buf, size_t bufsize) {
   buf[0] = 0;
 
@@ -193,7 +248,9 @@ leafEvalResult evaluate_as_leaf(searchNode *node, searchType_t type) {
   result.hash_table_move = 0;
 
   // get transposition table record if available.
+  PERFSTAT_SCOPE_BEGIN(tt_scope);
   ttRec_t *rec = tt_hashtable_get(node->position.key);
+  PERFSTAT_SCOPE_END(tt_scope, PERFSTAT_TT);
   if (rec) {
     if (type == SEARCH_SCOUT && tt_is_usable(rec, node->depth, node->beta)) {
       result.type = MOVE_EVALUATED;
@@ -204,7 +261,9 @@ leafEvalResult evaluate_as_leaf(searchNode *node, searchType_t type) {
   }
 
   // stand pat (having-the-move) bonus
+  PERFSTAT_SCOPE_BEGIN(eval_scope);
   score_t sps = eval(&(node->position), false) + HMB;
+  PERFSTAT_SCOPE_END(eval_scope, PERFSTAT_EVAL);
   bool quiescence = (node->depth <= 0);  // are we in quiescence?
   result.should_enter_quiescence = quiescence;
   if (quiescence) {
@@ -242,19 +301,34 @@ leafEvalResult evaluate_as_leaf(searchNode *node, searchType_t type) {
   return result;
 }
 
+// A node is a split point while its remaining moves are searched in
+// parallel: its children then hold its own token.
+static bool is_split_point(searchNode *node) {
+  return node->child_token != node->token;
+}
+
 // Evaluate the move by performing a search.
 void evaluateMove(searchNode *node, move_t mv, move_t killer_a,
                                   move_t killer_b, searchType_t type,
-                                  uint64_t *node_count_serial,
+                                  nodeCounter *node_count_serial,
                                   moveEvaluationResult *result) {
   int ext = 0;  // extensions
   bool blunder = false;  // shoot our own piece
-  result->next_node.subpv[0] = 0;
   result->next_node.parent = node;
+  if (type != SEARCH_SCOUT) {
+    result->next_node.pv = node->pv;
+    // a child that ends the game or is only scouted leaves no PV behind;
+    // at a split point, the re-search clears its own row
+    if (!is_split_point(node)) {
+      node->pv[node->ply + 1][0] = 0;
+    }
+  }
 
   // Make the move, and get any victim pieces.
+  PERFSTAT_SCOPE_BEGIN(make_move_scope);
   victims_t victims = make_move(&(node->position), &(result->next_node.position),
                                 mv);
+  PERFSTAT_SCOPE_END(make_move_scope, PERFSTAT_MAKE_MOVE);
 
   // Check whether this move changes the board state.
   //   such moves are not legal.
@@ -358,6 +432,11 @@ void evaluateMove(searchNode *node, move_t mv, move_t killer_a,
       result->score = -scout_search(&(result->next_node), search_depth,
                             node_count_serial);
       if (result->score > node->alpha) {
+        if (is_split_point(node)) {  // the caller re-searches
+          result->type = MOVE_RESEARCH;
+          result->research_depth = node->depth + ext - 1;
+          return;
+        }
         result->score = -searchPV(&(result->next_node), node->depth + ext - 1, node_count_serial);
       }
     }
@@ -390,24 +469,46 @@ void sort_incremental(sortable_move_t *move_list, int num_of_moves, int mv_index
   move_list[max_index] = old_val;
 }
 
-// Returns true if a cutoff was triggered, false otherwise.
+// Sorts move_list[lo, hi) by decreasing sort key, all at once.
+static void sort_tail(sortable_move_t *move_list, int lo, int hi) {
+  for (int i = lo + 1; i < hi; i++) {
+    sortable_move_t mv = move_list[i];
+    int j = i - 1;
+    while (j >= lo && move_list[j] < mv) {
+      move_list[j + 1] = move_list[j];
+      j--;
+    }
+    move_list[j + 1] = mv;
+  }
+}
+
+// Returns true if a cutoff was triggered, false otherwise.  child_pv is the
+// PV left by the child's searchPV, or NULL if it was only scouted.
 bool search_process_score(searchNode *node, move_t mv, int mv_index,
-                                moveEvaluationResult *result, searchType_t type) {
+                                moveEvaluationResult *result, searchType_t type,
+                                move_t *child_pv) {
   if (result->score > node->best_score) {
     node->best_score = result->score;
     node->best_move_index = mv_index;
-    node->subpv[0] = mv;
-
-    // write best move into right position in PV buffer.
-    memcpy(node->subpv + 1, result->next_node.subpv,
-           sizeof(move_t) * (MAX_PLY_IN_SEARCH - 1));
-    node->subpv[MAX_PLY_IN_SEARCH - 1] = 0;
+    node->best_move = mv;
+
+    // PV nodes extend the child's PV, left one row down, into their own row.
+    if (type != SEARCH_SCOUT) {
+      move_t *pv = node->pv[node->ply];
+      pv[0] = mv;
+      if (child_pv != NULL) {
+        copy_pv(pv + 1, child_pv, MAX_PLY_IN_SEARCH - node->ply - 1);
+      } else {
+        pv[1] = 0;
+      }
+    }
 
     if (type != SEARCH_SCOUT && result->score > node->alpha) {
       node->alpha = result->score;
     }
 
     if (result->score >= node->beta) {
+      move_t *killer = node->state->killer;
       if (mv != killer[KMT(node->ply, 0)] && ENABLE_TABLES) {
         killer[KMT(node->ply, 1)] = killer[KMT(node->ply, 0)];
         killer[KMT(node->ply, 0)] = mv;
@@ -418,28 +519,19 @@ bool search_process_score(searchNode *node, move_t mv, int mv_index,
   return false;
 }
 
-// Check if we should abort.
-bool should_abort_check() {
-  tics++;
-  if ((tics & ABORT_CHECK_PERIOD) == 0) {
-    if (milliseconds() >= timeout) {
-      abortf = true;
-      return true;
-    }
-  }
-  return false;
-}
-
 // Obtain a sorted move list.
 static int get_sortable_move_list(searchNode *node, sortable_move_t * move_list,
                          int hash_table_move) {
   // number of moves in list
+  PERFSTAT_SCOPE_BEGIN(movegen_scope);
   int num_of_moves = generate_all_opt(&(node->position), move_list, false);
+  PERFSTAT_SCOPE_END(movegen_scope, PERFSTAT_MOVEGEN);
 
   color_t fake_color_to_move = color_to_move_of(&(node->position));
 
-  move_t killer_a = killer[KMT(node->ply, 0)];
-  move_t killer_b = killer[KMT(node->ply, 1)];
+  move_t killer_a = node->state->killer[KMT(node->ply, 0)];
+  move_t killer_b = node->state->killer[KMT(node->ply, 1)];
+  int *best_move_history = node->state->best_move_history;
 
   // sort special moves to the front
   for (int mv_index = 0; mv_index < num_of_moves; mv_index++) {
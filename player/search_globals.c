@@ -1,26 +1,50 @@
 // Copyright (c) 2015 MIT License by 6.172 Staff
 
-#define __KMT_dim__ [MAX_PLY_IN_SEARCH*4]  // NOLINT(whitespace/braces)
+// Killer moves table lookup (see searchState::killer)
 #define KMT(ply, id) (4 * ply + id)
-static move_t killer __KMT_dim__;  // up to 4 killers
 
-// Best move history table and lookup function
-// Format: best_move_history[color_t][piece_t][square_t][orientation]
-#define __BMH_dim__ [2*6*ARR_SIZE*NUM_ORI]  // NOLINT(whitespace/braces)
+// Best move history table lookup (see searchState::best_move_history)
 #define BMH(color, piece, square, ori)                             \
     (color * 6 * ARR_SIZE * NUM_ORI + piece * ARR_SIZE * NUM_ORI + \
      square * NUM_ORI + ori)
 
-static int best_move_history __BMH_dim__;
+void init_search_state(searchState *state) {
+  memset(state, 0, sizeof(searchState));
+}
+
+void init_best_move_history(searchState *state) {
+  memset(state->best_move_history, 0, sizeof(state->best_move_history));
+}
+
+void node_counter_reset(nodeCounter *counter) {
+  memset(counter, 0, sizeof(nodeCounter));
+}
 
-void init_best_move_history() {
-  memset(best_move_history, 0, sizeof(best_move_history));
+uint64_t node_counter_total(nodeCounter *counter) {
+  uint64_t total = 0;
+  for (int i = 0; i < PAR_MAX_WORKERS; i++) {
+    total += counter->worker[i].nodes;
+  }
+  return total;
+}
+
+// Counts a child of node on the calling worker's slot, which no other worker
+// writes.
+static inline void count_node(nodeCounter *counter, searchNode *node) {
+  counter->worker[par_worker_id()].nodes++;
+#if PARPROF
+  if (node->child_token->aborted) {
+    PARPROF_COUNT(PARPROF_WASTED_NODES);
+  }
+#endif
 }
 
-static void update_best_move_history(position_t *p, int index_of_best,
+static void update_best_move_history(searchNode *node, int index_of_best,
                                      sortable_move_t* lst, int count) {
   tbassert(ENABLE_TABLES, "Tables weren't enabled.\n");
 
+  position_t *p = &(node->position);
+  int *best_move_history = node->state->best_move_history;
   int color_to_move = color_to_move_of(p);
 
   for (int i = 0; i < count; i++) {
@@ -45,6 +69,7 @@ static void update_best_move_history(position_t *p, int index_of_best,
 }
 
 static void update_transposition_table(searchNode* node) {
+  PERFSTAT_SCOPE_BEGIN(tt_scope);
   if (node->type == SEARCH_SCOUT) {
     if (node->best_score < node->beta) {
       tt_hashtable_put(node->position.key, node->depth,
@@ -53,7 +78,7 @@ static void update_transposition_table(searchNode* node) {
     } else {
       tt_hashtable_put(node->position.key, node->depth,
                        tt_adjust_score_for_hashtable(node->best_score, node->ply),
-                       LOWER, node->subpv[0]);
+                       LOWER, node->best_move);
     }
   } else if (node->type == SEARCH_PV) {
     if (node->best_score <= node->orig_alpha) {
@@ -61,10 +86,11 @@ static void update_transposition_table(searchNode* node) {
           tt_adjust_score_for_hashtable(node->best_score, node->ply), UPPER, 0);
     } else if (node->best_score >= node->beta) {
       tt_hashtable_put(node->position.key, node->depth,
-          tt_adjust_score_for_hashtable(node->best_score, node->ply), LOWER, node->subpv[0]);
+          tt_adjust_score_for_hashtable(node->best_score, node->ply), LOWER, node->best_move);
     } else {
       tt_hashtable_put(node->position.key, node->depth,
-          tt_adjust_score_for_hashtable(node->best_score, node->ply), EXACT, node->subpv[0]);
+          tt_adjust_score_for_hashtable(node->best_score, node->ply), EXACT, node->best_move);
     }
   }
+  PERFSTAT_SCOPE_END(tt_scope, PERFSTAT_TT);
 }
@@ -13,14 +13,50 @@
 // Checks whether a node's parent has aborted.
 //   If this occurs, we should just stop and return 0 immediately.
 bool parallel_parent_aborted(searchNode* node) {
-  searchNode* pred = node->parent;
-  while (pred != NULL) {
-    if (pred->abort) {
-      return true;
+  return node->token->aborted;
+}
+
+// Makes token a split point below parent, cancelled if parent already is.
+static void abort_token_register(abortToken *token, abortToken *parent) {
+  token->lock = 0;
+  token->children = NULL;
+  token->prev = NULL;
+  token->parent = parent;
+  simple_acquire(&parent->lock);
+  // read under the lock: a cancel either sees this token or set the flag first
+  token->aborted = parent->aborted;
+  token->next = parent->children;
+  if (parent->children != NULL) {
+    parent->children->prev = token;
+  }
+  parent->children = token;
+  simple_release(&parent->lock);
+}
+
+static void abort_token_unregister(abortToken *token) {
+  abortToken *parent = token->parent;
+  simple_acquire(&parent->lock);
+  if (token->prev != NULL) {
+    token->prev->next = token->next;
+  } else {
+    parent->children = token->next;
+  }
+  if (token->next != NULL) {
+    token->next->prev = token->prev;
+  }
+  simple_release(&parent->lock);
+}
+
+// Cancels token and every split point below it.
+static void abort_token_cancel(abortToken *token) {
+  token->aborted = true;
+  simple_acquire(&token->lock);
+  for (abortToken *child = token->children; child != NULL; child = child->next) {
+    if (!child->aborted) {
+      abort_token_cancel(child);
     }
-    pred = pred->parent;
   }
-  return false;
+  simple_release(&token->lock);
 }
 
 // Checks whether this node has aborted due to a cut-off.
@@ -37,26 +73,135 @@ bool parallel_node_aborted(searchNode* node) {
 //   https://chessprogramming.wikispaces.com/Null+Window
 static void initialize_scout_node(searchNode *node, int depth) {
   node->type = SEARCH_SCOUT;
+  node->state = node->parent->state;
   node->beta = -(node->parent->alpha);
   node->alpha = node->beta - 1;
   node->depth = depth;
   node->ply = node->parent->ply + 1;
-  node->subpv[0] = 0;
+  node->best_move = 0;
   node->legal_move_count = 0;
   node->fake_color_to_move = color_to_move_of(&(node->position));
   // point of view = 1 for white, -1 for black
   node->pov = 1 - node->fake_color_to_move * 2;
   node->best_move_index = 0;  // index of best move found
   node->abort = false;
+  node->token = node->parent->child_token;
+  node->child_token = node->token;
+}
+
+// The best score, its move index and whether it caused a cutoff, packed in
+// one word so that the parallel moves of a scout node publish their scores
+// with a compare-and-swap.  The biased score sits in the high bits.
+typedef uint64_t packedBest;
+
+static packedBest pack_best(score_t score, int index, bool cutoff) {
+  return ((uint64_t) (uint16_t) (score + 32768) << 32) |
+         ((uint64_t) cutoff << 16) | (uint16_t) index;
+}
+
+static score_t best_score_of(packedBest best) {
+  return (score_t) ((int) ((best >> 32) & 0xffff) - 32768);
+}
+
+static int best_index_of(packedBest best) {
+  return best & 0xffff;
+}
+
+// The moves of a scout node after the first BEST_MOVE_HEADER, which are
+// searched in parallel.  They are sorted beforehand, so each iteration
+// claims the next move with a fetch-and-add.
+typedef struct scoutLoop {
+  searchNode *node;
+  sortable_move_t *move_list;
+  int *number_of_moves_evaluated;
+  packedBest best;
+  abortToken *token;  // of this split point
+  simple_mutex_t *node_mutex;
+  move_t killer_a;
+  move_t killer_b;
+  nodeCounter *node_count_serial;
+} scoutLoop;
+
+// Publishes score if it improves on the best so far.  Returns true if it
+// caused a cutoff.
+static bool scout_publish_score(scoutLoop *loop, move_t mv, int index,
+                                score_t score) {
+  searchNode *node = loop->node;
+  packedBest old = __atomic_load_n(&loop->best, __ATOMIC_RELAXED);
+  while (score > best_score_of(old)) {
+    bool cutoff = (score >= node->beta);
+    if (__atomic_compare_exchange_n(&loop->best, &old,
+                                    pack_best(score, index, cutoff), true,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      if (cutoff && ENABLE_TABLES) {
+        move_t *killer = node->state->killer;
+        simple_acquire(loop->node_mutex);
+        if (mv != killer[KMT(node->ply, 0)]) {
+          killer[KMT(node->ply, 1)] = killer[KMT(node->ply, 0)];
+          killer[KMT(node->ply, 0)] = mv;
+        }
+        simple_release(loop->node_mutex);
+      }
+      return cutoff;
+    }
+  }
+  return false;
+}
+
+// Searches the next unclaimed move of a scout node; one parallel iteration.
+static void scout_search_move(void *ctx, int mv_index) {
+  scoutLoop *loop = (scoutLoop *) ctx;
+  searchNode *node = loop->node;
+
+  if (node->abort) return;
+
+  int local_index = __sync_fetch_and_add(loop->number_of_moves_evaluated, 1);
+
+  // Get the next move from the move list.
+  move_t mv = get_move(loop->move_list[local_index]);
+
+  if (TRACE_MOVES) {
+    print_move_info(mv, node->ply);
+  }
+
+  // increase node count
+  count_node(loop->node_count_serial, node);
+
+  moveEvaluationResult result;
+  evaluateMove(node, mv, loop->killer_a, loop->killer_b,
+               SEARCH_SCOUT,
+               loop->node_count_serial,
+               &result);
+
+  if (loop->token->aborted) {  // cut off meanwhile, here or above
+    PARPROF_COUNT(PARPROF_ABORTED);
+    return;
+  }
+
+  if (result.type == MOVE_ILLEGAL || result.type == MOVE_IGNORE
+      || abortf || parallel_parent_aborted(node)) {
+    return;
+  }
+
+  // A legal move is a move that's not KO, but when we are in quiescence
+  // we only want to count moves that has a capture.
+  if (result.type == MOVE_EVALUATED) {
+    __sync_fetch_and_add(&node->legal_move_count, 1);
+  }
+  if (scout_publish_score(loop, mv, local_index, result.score)) {
+    PARPROF_COUNT(PARPROF_CUTOFFS);
+    node->abort = true;
+    abort_token_cancel(loop->token);
+  }
 }
 
 static score_t scout_search(searchNode *node, int depth,
-                            uint64_t *node_count_serial) {
+                            nodeCounter *node_count_serial) {
   // Initialize the search node.
   initialize_scout_node(node, depth);
 
   // check whether we should abort
-  if (should_abort_check() || parallel_parent_aborted(node)) {
+  if (abortf || parallel_parent_aborted(node)) {
     return 0;
   }
 
@@ -75,8 +220,8 @@ static score_t scout_search(searchNode *node, int depth,
   node->quiescence = pre_evaluation_result.should_enter_quiescence;
 
   // Grab the killer-moves for later use.
-  move_t killer_a = killer[KMT(node->ply, 0)];
-  move_t killer_b = killer[KMT(node->ply, 1)];
+  move_t killer_a = node->state->killer[KMT(node->ply, 0)];
+  move_t killer_b = node->state->killer[KMT(node->ply, 1)];
 
   // Store the sorted move list on the stack.
   //   MAX_NUM_MOVES is all that we need.
@@ -87,12 +232,14 @@ static score_t scout_search(searchNode *node, int depth,
 
   int number_of_moves_evaluated = 0;
 
-
-  // A simple mutex. See simple_mutex.h for implementation details.
-  simple_mutex_t node_mutex;
-  init_simple_mutex(&node_mutex);
- 
+  // The first BEST_MOVE_HEADER moves are searched serially before the rest
+  // are spawned.  A serial search simply runs every move in this loop, and
+  // so do quiescence nodes and nodes below SERIAL_DEPTH, whose subtrees are
+  // too small to pay for a spawn.
   int bound = BEST_MOVE_HEADER < num_of_moves ? BEST_MOVE_HEADER : num_of_moves;
+  if (node->state->serial || node->quiescence || depth < SERIAL_DEPTH) {
+    bound = num_of_moves;
+  }
   for (int mv_index = 0; mv_index < bound; mv_index++) {
     // Sort up to number_of_moves_evaluated
     sort_incremental(move_list, num_of_moves, number_of_moves_evaluated);
@@ -106,7 +253,7 @@ static score_t scout_search(searchNode *node, int depth,
     }
 
     // increase node count
-    __sync_fetch_and_add(node_count_serial, 1);
+    count_node(node_count_serial, node);
 
     moveEvaluationResult result;
     evaluateMove(node, mv, killer_a, killer_b,
@@ -124,59 +271,35 @@ static score_t scout_search(searchNode *node, int depth,
       node->legal_move_count++;
     }
     // process the score. Note that this mutates fields in node.
-    bool cutoff = search_process_score(node, mv, local_index, &result, SEARCH_SCOUT);
+    bool cutoff = search_process_score(node, mv, local_index, &result, SEARCH_SCOUT,
+                                       NULL);
     if (cutoff) {
       node->abort = true;
       break;
     }
   }
 
-  if (!node->abort) {
-    cilk_for (int mv_index = BEST_MOVE_HEADER; mv_index < num_of_moves; mv_index++) {
-      do {
-        if (node->abort) continue;
-        
-        simple_acquire(&node_mutex);
-        // Sort up to number_of_moves_evaluated
-        sort_incremental(move_list, num_of_moves, number_of_moves_evaluated);
-        int local_index = number_of_moves_evaluated++;
-        simple_release(&node_mutex);
-
-        // Get the next move from the move list.
-        move_t mv = get_move(move_list[local_index]);
-
-        if (TRACE_MOVES) {
-          print_move_info(mv, node->ply);
-        }
-
-        // increase node count
-        __sync_fetch_and_add(node_count_serial, 1);
-
-        moveEvaluationResult result;
-        evaluateMove(node, mv, killer_a, killer_b,
-                     SEARCH_SCOUT,
-                     node_count_serial,
-                     &result);
-
-        if (result.type == MOVE_ILLEGAL || result.type == MOVE_IGNORE
-            || abortf || parallel_parent_aborted(node)) {
-          continue;
-        }
-
-        // A legal move is a move that's not KO, but when we are in quiescence
-        // we only want to count moves that has a capture.
-        if (result.type == MOVE_EVALUATED) {
-          __sync_fetch_and_add(&node->legal_move_count, 1);
-        }
-        simple_acquire(&node_mutex);
-        // process the score. Note that this mutates fields in node.
-        bool cutoff = search_process_score(node, mv, local_index, &result, SEARCH_SCOUT);
-        simple_release(&node_mutex);
-        if (cutoff) {
-          node->abort = true;
-          continue;
-        }
-      } while (false);
+  if (!node->abort && bound < num_of_moves) {
+    sort_tail(move_list, bound, num_of_moves);
+    // A simple mutex. See simple_mutex.h for implementation details.
+    simple_mutex_t node_mutex;
+    init_simple_mutex(&node_mutex);
+    abortToken token;
+    abort_token_register(&token, node->token);
+    node->child_token = &token;
+    scoutLoop loop = {
+      node, move_list, &number_of_moves_evaluated,
+      pack_best(node->best_score, node->best_move_index, false),
+      &token, &node_mutex, killer_a, killer_b, node_count_serial
+    };
+    par_for(bound, num_of_moves, scout_search_move, &loop, &node->abort);
+    abort_token_unregister(&token);
+    node->child_token = node->token;
+
+    node->best_score = best_score_of(loop.best);
+    if (best_index_of(loop.best) != node->best_move_index) {
+      node->best_move_index = best_index_of(loop.best);
+      node->best_move = get_move(move_list[node->best_move_index]);
     }
   }
 
@@ -185,7 +308,7 @@ static score_t scout_search(searchNode *node, int depth,
   }
 
   if (node->quiescence == false) {
-    update_best_move_history(&(node->position), node->best_move_index,
+    update_best_move_history(node, node->best_move_index,
                              move_list, number_of_moves_evaluated);
   }
 
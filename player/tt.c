@@ -6,8 +6,15 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include "./parallel.h"
 #include "./tbassert.h"
 
+// The table is mapped in multiples of a 2 MB huge page, and cleared one huge
+// page per parallel iteration so that each page is first touched by a worker (and
+// hence allocated on that worker's NUMA node).
+#define TT_HUGE_PAGE_SIZE (2ULL << 20)
+
 int HASH;     // hash table size in MBytes
 int USE_TT;   // Use the transposition table.
 // Turn off for deterministic behavior of the search.
@@ -37,6 +44,8 @@ struct ttHashtable {
   uint64_t mask;           // a mask to map from key to set index
   unsigned age;
   ttSet_t *tt_set;         // array of sets that contains the transposition
+  size_t   map_size;       // bytes mapped for tt_set
+  size_t   page_size;      // size of the pages backing tt_set
 } hashtable;  // name of the global transposition table
 
 
@@ -58,6 +67,96 @@ uint32_t tt_get_num_of_records() {
   return hashtable.num_of_sets * RECORDS_PER_SET;
 }
 
+size_t tt_get_page_size() {
+  return hashtable.page_size;
+}
+
+// Whether transparent huge pages are turned off system-wide, in which case
+// madvise(MADV_HUGEPAGE) succeeds but has no effect.
+static bool tt_thp_disabled() {
+  FILE *f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+  if (f == NULL) {
+    return true;
+  }
+  char buf[64] = "";
+  if (fgets(buf, sizeof(buf), f) == NULL) {
+    buf[0] = '\0';
+  }
+  fclose(f);
+  return strstr(buf, "[never]") != NULL;
+}
+
+// Maps map_size bytes (a multiple of TT_HUGE_PAGE_SIZE) for the table.  Tries
+// explicit huge pages first, then a huge-page aligned mapping advised for
+// transparent huge pages, and finally settles for ordinary pages.  Sets
+// hashtable.page_size to the page size that backs the mapping.
+static ttSet_t *tt_map_sets(size_t map_size) {
+  void *mem;
+
+#ifdef MAP_HUGETLB
+  mem = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (mem != MAP_FAILED) {
+    hashtable.page_size = TT_HUGE_PAGE_SIZE;
+    return (ttSet_t *) mem;
+  }
+#endif
+
+  // Over-allocate by one huge page so the table can start on a huge page
+  // boundary, then give back the slack at both ends.
+  mem = mmap(NULL, map_size + TT_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    return NULL;
+  }
+  uintptr_t start = (uintptr_t) mem;
+  uintptr_t aligned = (start + TT_HUGE_PAGE_SIZE - 1) & ~(TT_HUGE_PAGE_SIZE - 1);
+  if (aligned > start) {
+    munmap(mem, aligned - start);
+  }
+  if (aligned + map_size < start + map_size + TT_HUGE_PAGE_SIZE) {
+    munmap((void *) (aligned + map_size),
+           start + TT_HUGE_PAGE_SIZE - aligned);
+  }
+
+  hashtable.page_size = sysconf(_SC_PAGESIZE);
+#ifdef MADV_HUGEPAGE
+  if (madvise((void *) aligned, map_size, MADV_HUGEPAGE) == 0 &&
+      !tt_thp_disabled()) {
+    hashtable.page_size = TT_HUGE_PAGE_SIZE;
+  }
+#endif
+  return (ttSet_t *) aligned;
+}
+
+static void tt_unmap_sets() {
+  if (hashtable.tt_set != NULL) {
+    munmap(hashtable.tt_set, hashtable.map_size);
+  }
+  hashtable.tt_set = NULL;
+  hashtable.map_size = 0;
+}
+
+// Zeroes huge page i of the table.
+static void tt_clear_page(void *ctx, int i) {
+  char *base = (char *) hashtable.tt_set;
+  uint64_t num_of_bytes = sizeof(ttSet_t) * hashtable.num_of_sets;
+  uint64_t offset = i * TT_HUGE_PAGE_SIZE;
+  uint64_t len = num_of_bytes - offset;
+  if (len > TT_HUGE_PAGE_SIZE) {
+    len = TT_HUGE_PAGE_SIZE;
+  }
+  memset(base + offset, 0, len);
+}
+
+// Zeroes the table in parallel, one huge page per iteration.
+static void tt_parallel_clear() {
+  uint64_t num_of_bytes = sizeof(ttSet_t) * hashtable.num_of_sets;
+  uint64_t num_of_chunks = (num_of_bytes + TT_HUGE_PAGE_SIZE - 1) / TT_HUGE_PAGE_SIZE;
+
+  par_for(0, num_of_chunks, tt_clear_page, NULL, NULL);
+}
+
 void tt_resize_hashtable(int size_in_meg) {
   uint64_t size_in_bytes = (uint64_t) size_in_meg * (1ULL << 20);
   // total number of sets we could have in the hashtable
@@ -72,26 +171,31 @@ void tt_resize_hashtable(int size_in_meg) {
   hashtable.mask = num_of_sets - 1;
   hashtable.age = 0;
 
-  free(hashtable.tt_set);  // free the old ones
-  hashtable.tt_set = (ttSet_t *) malloc(sizeof(ttSet_t) * num_of_sets);
+  tt_unmap_sets();  // free the old ones
+  uint64_t num_of_bytes = sizeof(ttSet_t) * num_of_sets;
+  size_t map_size = (num_of_bytes + TT_HUGE_PAGE_SIZE - 1) & ~(TT_HUGE_PAGE_SIZE - 1);
+  hashtable.tt_set = tt_map_sets(map_size);
 
   if (hashtable.tt_set == NULL) {
     fprintf(stderr,  "Hash table too big\n");
     exit(1);
   }
+  hashtable.map_size = map_size;
 
-  // might as well clear the table while we are at it
-  memset(hashtable.tt_set, 0, sizeof(ttSet_t) * hashtable.num_of_sets);
+  // Fresh anonymous pages are already zero, but clearing them here places
+  // the first touch of every page on the workers rather than on whichever
+  // thread happens to probe it first.
+  tt_parallel_clear();
 }
 
 void tt_make_hashtable(int size_in_meg) {
   hashtable.tt_set = NULL;
+  hashtable.map_size = 0;
   tt_resize_hashtable(size_in_meg);
 }
 
 void tt_free_hashtable() {
-  free(hashtable.tt_set);
-  hashtable.tt_set = NULL;
+  tt_unmap_sets();
 }
 
 // age the hash table by incrementing global age
@@ -100,7 +204,7 @@ void tt_age_hashtable() {
 }
 
 void tt_clear_hashtable() {
-  memset(hashtable.tt_set, 0, sizeof(ttSet_t) * hashtable.num_of_sets);
+  tt_parallel_clear();
   hashtable.age = 0;
 }
 
@@ -31,12 +31,14 @@ score_t tt_score_of(ttRec_t *tt);
 
 size_t tt_get_bytes_per_record();
 uint32_t tt_get_num_of_records();
+size_t tt_get_page_size();
 
 // operations on the global hashtable
 void tt_make_hashtable(int sizeMeg);
 void tt_resize_hashtable(int sizeInMeg);
 void tt_free_hashtable();
 void tt_age_hashtable();
+void tt_clear_hashtable();
 
 // putting / getting transposition data into / from hashtable
 void tt_hashtable_put(uint64_t key, int depth, score_t score,
@@ -39,14 +39,31 @@ double milliseconds() {
 #endif
 }
 
+// Seed variables
+#define MYRAND_X  123456789123ULL
+#define MYRAND_Y  987654321987ULL
+#define MYRAND_Z1 43219876
+#define MYRAND_C1 6543217
+#define MYRAND_Z2 21987643
+#define MYRAND_C2 1732654
+
+static uint64_t x = MYRAND_X, y = MYRAND_Y;
+static unsigned int z1 = MYRAND_Z1, c1 = MYRAND_C1, z2 = MYRAND_Z2,
+    c2 = MYRAND_C2;
+
+// SplitMix64 on a caller-owned state, for threads that each need their own
+// reproducible sequence.  Any seed, 0 included, is fine.
+uint64_t myrand_r(uint64_t *state) {
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
 // Public domain code for JLKISS64 RNG - long period KISS RNG producing
 // 64-bit results
 uint64_t myrand() {
   static int first_time = 0;
-  // Seed variables
-  static uint64_t x = 123456789123ULL, y = 987654321987ULL;
-  static unsigned int z1 = 43219876, c1 = 6543217, z2 = 21987643,
-      c2 = 1732654;  // Seed variables
   static uint64_t t;
 
   if (first_time) {
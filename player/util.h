@@ -33,5 +33,6 @@
 void debug_log(int log_level, const char *str, ...);
 double  milliseconds();
 uint64_t myrand();
+uint64_t myrand_r(uint64_t *state);
 
 #endif  // UTIL_H
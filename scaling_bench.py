@@ -0,0 +1,198 @@
+#!/usr/bin/python
+
+"""
+Measures how the parallel search of a player scales with the number of workers
+
+For every position of a bench set, the player runs 'bench <depth> parallel' at
+1, 2, 4, ..., N workers, and 'bench <depth> serial' once, all from an empty hash
+table.  The whole set is run --repeats times, with the worker counts interleaved
+so that drift in the machine's load affects them alike.
+
+ - Statistics, per number of workers, as a mean and a 95% confidence interval
+   over the repetitions
+
+       TIME_TO_DEPTH : total time (ms) to search every position to the depth
+       SPEEDUP       : time to depth at 1 worker / time to depth at N workers
+       NPS           : total nodes / total time
+       NPS_SCALING   : NPS at N workers / NPS at 1 worker
+       OVERHEAD      : nodes at N workers / nodes of the serial search
+
+   SPEEDUP and NPS_SCALING pair the runs of the same repetition.
+
+ - Output
+
+   The summary is printed as a table, and with --json written as a list with
+   one object per number of workers, each statistic as {"mean", "ci95"}.
+   With --csv, every search (repetition, workers, position) is written as a
+   row, 'serial' standing for the serial search in the workers column.
+"""
+
+import sys
+import csv
+import json
+import math
+import argparse
+import multiprocessing
+from subprocess import Popen, PIPE
+
+## Globals
+
+class bcolors:
+    HEADER = '\033[95m'
+    OKBLUE = '\033[94m'
+    OKGREEN = '\033[92m'
+    WARNING = '\033[93m'
+    FAIL = '\033[91m'
+    ENDC = '\033[0m'
+
+DEFAULT_POSITIONS = 'tests/bench.pos'
+
+# Two-sided 95% quantiles of Student's t distribution, by degrees of freedom
+T_95 = [12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042]
+
+CSV_FIELDS = ['repeat', 'workers', 'position', 'bestmove', 'score', 'nodes',
+              'time', 'nps']
+
+## Utilities
+
+# Worker counts 1, 2, 4, ... up to and including max_workers
+def worker_counts(max_workers):
+  counts = []
+  n = 1
+  while n < max_workers:
+    counts.append(n)
+    n *= 2
+  counts.append(max_workers)
+  return counts
+
+# Read the bench set: one "position" argument per line, '#' for comments
+def read_positions(f_name):
+  positions = []
+  with open(f_name, 'r') as f:
+    for line in f:
+      line = line.strip()
+      if line and not line.startswith('#'):
+        positions.append(line)
+  return positions
+
+# Return mean and half-width of the 95% confidence interval of l
+def mean_ci(l):
+  n = len(l)
+  mean = sum(l) / float(n)
+  if n < 2:
+    return mean, 0.0
+  var = sum((x - mean) ** 2 for x in l) / (n - 1)
+  t = T_95[n - 2] if n - 2 < len(T_95) else 1.96
+  return mean, t * math.sqrt(var / n)
+
+# Parse "bench <mode> bestmove <m> score cp <s> nodes <n> time <t> nps <r>"
+def parse_bench(line):
+  tok = line.split()
+  return {'bestmove': tok[3], 'score': int(tok[6]), 'nodes': int(tok[8]),
+          'time': int(tok[10]), 'nps': int(tok[12])}
+
+# Run the bench set once; returns one result per position
+def run_set(exe, positions, depth, workers):
+  mode = 'serial' if workers is None else 'parallel'
+  args = [exe] if workers is None else [exe, '--threads', str(workers)]
+  cmds = ''.join('position %s\nbench %d %s\n' % (pos, depth, mode)
+                 for pos in positions) + 'quit\n'
+  out, _ = Popen(args, stdin=PIPE, stdout=PIPE).communicate(cmds)
+  results = [parse_bench(line) for line in out.splitlines()
+             if line.startswith('bench ' + mode)]
+  if len(results) != len(positions):
+    print bcolors.FAIL + 'Player output did not have a result for every position:'
+    print out + bcolors.ENDC
+    sys.exit(1)
+  return results
+
+# Print the summary table
+def print_summary(summary):
+  print '\n' + bcolors.HEADER + 'Summary (mean +- 95% CI):' + bcolors.ENDC
+  print '%8s %22s %16s %20s %16s %16s' % ('WORKERS', 'TIME_TO_DEPTH (ms)',
+      'SPEEDUP', 'NPS', 'NPS_SCALING', 'OVERHEAD')
+  for row in summary:
+    print '%8d %13.0f +- %-5.0f %7.2f +- %-5.2f %11.0f +- %-6.0f %7.2f +- %-5.2f %7.3f +- %-5.3f' % (
+        row['workers'],
+        row['time_to_depth'][0], row['time_to_depth'][1],
+        row['speedup'][0], row['speedup'][1],
+        row['nps'][0], row['nps'][1],
+        row['nps_scaling'][0], row['nps_scaling'][1],
+        row['overhead'][0], row['overhead'][1])
+
+if __name__ == '__main__':
+  parser = argparse.ArgumentParser(
+      description='Thread-scaling benchmark of a leiserchess player')
+  parser.add_argument('exe', help='leiserchess executable to benchmark')
+  parser.add_argument('--positions', default=DEFAULT_POSITIONS,
+                      help='bench set (default %s)' % DEFAULT_POSITIONS)
+  parser.add_argument('--depth', type=int, default=6,
+                      help='search depth (default 6)')
+  parser.add_argument('--max-workers', type=int,
+                      default=multiprocessing.cpu_count(),
+                      help='largest number of workers (default: all cpus)')
+  parser.add_argument('--repeats', type=int, default=3,
+                      help='repetitions of every configuration (default 3)')
+  parser.add_argument('--csv', help='write every search to this file')
+  parser.add_argument('--json', help='write the summary to this file')
+  args = parser.parse_args()
+
+  positions = read_positions(args.positions)
+  counts = worker_counts(args.max_workers)
+
+  print bcolors.OKBLUE + 'Running %d positions to depth %d at %s workers, %d times...' % (
+      len(positions), args.depth, ', '.join(str(n) for n in counts),
+      args.repeats) + bcolors.ENDC
+
+  rows = []
+  serial_nodes = []  # per repetition
+  totals = {}        # workers -> [(time, nodes)] per repetition
+  for r in range(args.repeats):
+    for workers in [None] + counts:
+      results = run_set(args.exe, positions, args.depth, workers)
+      time = sum(res['time'] for res in results)
+      nodes = sum(res['nodes'] for res in results)
+      if workers is None:
+        serial_nodes.append(nodes)
+      else:
+        totals.setdefault(workers, []).append((time, nodes))
+      for pos, res in enumerate(results):
+        row = dict(res)
+        row.update({'repeat': r, 'position': pos,
+                    'workers': 'serial' if workers is None else workers})
+        rows.append(row)
+      print '  repeat %d, %s: %d ms, %d nodes' % (
+          r, 'serial' if workers is None else '%d workers' % workers,
+          time, nodes)
+
+  summary = []
+  for workers in counts:
+    runs = totals[workers]
+    base = totals[1]
+    summary.append({
+        'workers': workers,
+        'time_to_depth': mean_ci([t for t, n in runs]),
+        'speedup': mean_ci([base[r][0] / float(max(t, 1))
+                            for r, (t, n) in enumerate(runs)]),
+        'nps': mean_ci([1000.0 * n / max(t, 1) for t, n in runs]),
+        'nps_scaling': mean_ci([(n / float(max(t, 1))) /
+                                (base[r][1] / float(max(base[r][0], 1)))
+                                for r, (t, n) in enumerate(runs)]),
+        'overhead': mean_ci([n / float(serial_nodes[r])
+                             for r, (t, n) in enumerate(runs)]),
+    })
+
+  print_summary(summary)
+
+  if args.csv:
+    with open(args.csv, 'wb') as f:
+      writer = csv.DictWriter(f, fieldnames=CSV_FIELDS)
+      writer.writeheader()
+      writer.writerows(rows)
+  if args.json:
+    with open(args.json, 'w') as f:
+      json.dump([dict((k, {'mean': v[0], 'ci95': v[1]} if isinstance(v, tuple) else v)
+                      for k, v in row.iteritems()) for row in summary],
+                f, indent=2, sort_keys=True)
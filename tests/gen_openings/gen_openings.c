@@ -13,19 +13,14 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
-#include <cilk/cilk.h>
-#include <cilk/reducer.h>
-
 #include "../../player/eval.h"
 #include "../../player/fen.h"
 #include "../../player/move_gen.h"
+#include "../../player/parallel.h"
 #include "../../player/search.h"
 #include "../../player/tt.h"
 #include "../../player/util.h"
 
-//#include "../../player/speculative_add.h"
-//#include "../../player/abort.h"
-
 char  VERSION[] = "1038";
 
 
@@ -53,6 +48,9 @@ extern int USE_NMM;
 extern int FUT_DEPTH;
 extern int TRACE_MOVES;
 extern int DETECT_DRAWS;
+extern int MULTIPV;
+extern int PV_SPLIT;
+extern int SERIAL_DEPTH;
 
 // defined in eval.c
 extern int RANDOMIZE;
@@ -97,6 +95,9 @@ static int_options iopts[] = {
   { "lmr_r2",                   &LMR_R2,   20,                    1,              MAX_NUM_MOVES },
   { "hmb",                         &HMB,   0.03 * PAWN_VALUE,     0,              PAWN_VALUE    },
   { "fut_depth",             &FUT_DEPTH,   3,                     0,              5             },
+  { "multipv",                 &MULTIPV,   1,                     1,              MAX_MULTIPV   },
+  { "pv_split",               &PV_SPLIT,   1,                     0,              1             },
+  { "serial_depth",       &SERIAL_DEPTH,   3,                     0,              MAX_PLY_IN_SEARCH },
   // debug options
   { "use_nmm",                 &USE_NMM,   1,                     0,              1             },
   { "detect_draws",       &DETECT_DRAWS,   1,                     0,              1             },
@@ -170,9 +171,8 @@ static move_t bestMoveSoFar;
 static char theMove[MAX_CHARS_IN_MOVE];
 
 static pthread_mutex_t entry_mutex;
-//static Abort glob_abort;
-//static Speculative_add node_count_parallel;
-static uint64_t node_count_serial;
+static nodeCounter node_count_serial;
+static searchState uci_state;  // zero-initialized, like init_search_state
 
 typedef struct {
   position_t *p;
@@ -193,31 +193,19 @@ void *entry_point(void *arg) {
   // start time of search
   init_abort_timer(tme);
 
-  init_best_move_history();
+  init_best_move_history(&uci_state);
   tt_age_hashtable();
 
-  init_tics();
+  par_begin();
 
   for (int d = 1; d <= depth; d++) {  // Iterative deepening
     reset_abort();
 
     searchRoot(p, -INF, INF, d, 0, subpv, &node_count_serial,
-                OUT);
+                OUT, &uci_state);
 
     et = elapsed_time();
 
-#if PARALLEL
-    // If we haven't aborted yet, store the best move we found.  Or, if we did
-    // abort and haven't finished searching a single level, just take whatever
-    // score we have for the principal variation node
-    if (!is_aborted(&glob_abort) || d == 1) {
-      bestMoveSoFar = subpv[0];
-    } else {
-      // we will use the bestMoveSoFar from the last level of iterative
-      // deepening
-      break;
-    }
-#else
     bestMoveSoFar = subpv[0];
 
     if (!should_abort()) {
@@ -225,11 +213,11 @@ void *entry_point(void *arg) {
     } else {
       break;
     }
-#endif
 
     // don't start iteration that you cannot complete
     if (et > tme * RATIO_FOR_TIMEOUT) break;
   }
+  par_end();
 
   // This unlock will allow the main thread lock/unlock in UCIBeginSearch to
   // proceed
@@ -246,31 +234,8 @@ void UciBeginSearch(position_t *p, int depth, double tme) {
   args.p = p;
   args.tme = tme;
 
-#if PARALLEL
-  abort_constructor(&glob_abort, NULL);
-#else
-  node_count_serial = 0;
-#endif
-
-#if PARALLEL
-  pthread_t play_thread;
-  pthread_create(&play_thread, NULL, &entry_point, &args);
-
-  // If we aren't searching to a fixed depth, terminate after a time threshold
-  // has passed
-  if (depth == INF_DEPTH) {
-    usleep(tme*100);
-    do_abort(&glob_abort);
-  }
-
-  // these two lines implement a barrier (see mutex_unlock in UCIBeginSearch)
-  pthread_mutex_lock(&entry_mutex);
-  pthread_mutex_unlock(&entry_mutex);
-
-  CILK_C_UNREGISTER_REDUCER(node_count_parallel);
-#else
+  node_counter_reset(&node_count_serial);
   entry_point(&args);
-#endif
 
   char bms[MAX_CHARS_IN_MOVE];
   move_to_str(bestMoveSoFar, bms, MAX_CHARS_IN_MOVE);
@@ -438,6 +403,7 @@ int main(int argc, char *argv[]) {
   OUT = stdout;
 
   init_options();
+  init_eval();
   init_zob();
 
 
@@ -26,57 +26,171 @@ import sys
 import string, cgi, time
 import os, subprocess
 import json
+import threading, Queue, collections
 from BaseHTTPServer import BaseHTTPRequestHandler, HTTPServer
+from SocketServer import ThreadingMixIn
 
 PLAYER = "../player/leiserchess"
-player_in = None
-player_out = None
+NUM_ENGINES = 2         # engine processes serving the /move/ requests
+CACHE_SIZE = 1024       # finished analyses kept, least recently used first out
+POLL_WAIT = 5.0         # seconds a /poll/ waits for its move before returning None
+LATENCY_SAMPLES = 1000  # most recent requests the latency stats are taken over
+
+# An engine process, used by one request at a time
+class Engine:
+    def __init__(self, number):
+        self.number = number
+        self.start()
+
+    def start(self):
+        self.proc = subprocess.Popen(PLAYER, stdin=subprocess.PIPE, stdout=subprocess.PIPE, shell=True)
+        self.proc.stdin.write('uci\n')
+        self.proc.stdin.flush()
+        while True:
+            line = self.proc.stdout.readline()
+            if not line or line.strip() == "uciok":
+                break
+
+    # Returns the best move and the engine output, or None if the engine died
+    def play(self, position, moves, time, inc):
+        if len(moves) > 0:
+          args = \
+              'position ' + position + ' ' + \
+              'moves ' + moves + '\n' + \
+              'go ' + \
+              'time ' + time + ' ' + \
+              'inc ' + inc + '\n'
+        else:
+          args = \
+             'position ' + position + '\n' + \
+             'go ' + \
+             'time ' + time + ' ' + \
+             'inc ' + inc + '\n'
+
+        print '[engine ' + str(self.number) + '] ' + args,
+        info = ''
+        try:
+            self.proc.stdin.write(args)
+            self.proc.stdin.flush()
+            line = self.proc.stdout.readline().strip()
+        except IOError:
+            line = ''
+        while True:
+            if not line:
+                print "ERROR: Leiserchess Player Terminated"
+                return None, info
+            info += line + '\n'
+
+            if line.startswith("bestmove "):
+                return line.split(" ")[1], info
+            line = self.proc.stdout.readline().strip()
+
+# A /move/ request, answered by /poll/
+class Request:
+    def __init__(self, key):
+        self.key = key
+        self.move = None
+        self.info = ''
+        self.done = threading.Event()
+        self.queued = time.time()
+
+# Engines waiting for work and requests waiting for engines, with the
+# finished analyses cached by position, moves and time control
+class EnginePool:
+    def __init__(self, size):
+        self.lock = threading.Lock()
+        self.requests = Queue.Queue()
+        self.cache = collections.OrderedDict()
+        self.running = dict()  # key -> request being searched or queued
+        self.busy = 0
+        self.served = 0
+        self.hits = 0
+        self.failures = 0
+        self.waits = collections.deque(maxlen=LATENCY_SAMPLES)
+        self.searches = collections.deque(maxlen=LATENCY_SAMPLES)
+        self.size = size
+        for i in range(size):
+            t = threading.Thread(target=self.serve, args=(Engine(i),))
+            t.daemon = True
+            t.start()
+
+    # Returns a request for the search, which may be finished already
+    def submit(self, position, moves, gotime, goinc):
+        key = (position, moves, gotime, goinc)
+        with self.lock:
+            if key in self.cache:
+                req = Request(key)
+                req.move, req.info = self.cache.pop(key)
+                self.cache[key] = (req.move, req.info)
+                req.done.set()
+                self.hits += 1
+                return req
+            if key in self.running:  # a refresh of a position being searched
+                self.hits += 1
+                return self.running[key]
+            req = Request(key)
+            self.running[key] = req
+        self.requests.put(req)
+        return req
+
+    def serve(self, engine):
+        while True:
+            req = self.requests.get()
+            start = time.time()
+            with self.lock:
+                self.busy += 1
+                self.waits.append(start - req.queued)
+
+            move, info = engine.play(*req.key)
+            if move is None:  # restart the engine and try once more
+                engine.start()
+                move, info = engine.play(*req.key)
+            req.move = move
+            req.info = info
+
+            with self.lock:
+                self.busy -= 1
+                self.served += 1
+                self.searches.append(time.time() - start)
+                del self.running[req.key]
+                if move is None:
+                    self.failures += 1
+                else:
+                    self.cache[req.key] = (move, info)
+                    if len(self.cache) > CACHE_SIZE:
+                        self.cache.popitem(last=False)
+            req.done.set()
+
+    def stats(self):
+        def summary(samples):
+            s = sorted(samples)
+            if not s:
+                return {}
+            return {
+              "mean": sum(s) / len(s),
+              "p50": s[len(s) / 2],
+              "p90": s[len(s) * 9 / 10],
+              "max": s[-1]
+            }
 
-info = ''
+        with self.lock:
+            return {
+              "engines": self.size,
+              "busy": self.busy,
+              "queued": self.requests.qsize(),
+              "served": self.served,
+              "cache_hits": self.hits,
+              "cache_entries": len(self.cache),
+              "failures": self.failures,
+              "wait_sec": summary(self.waits),
+              "search_sec": summary(self.searches)
+            }
+
+pool = None
 
 next_req_id = 0
 pending_requests = dict()
-
-def play(position, moves, time, inc):
-    if len(moves) > 0:
-      args = \
-          'position ' + position + ' ' + \
-          'moves ' + moves + '\n' + \
-          'go ' + \
-          'time ' + time + ' ' + \
-          'inc ' + inc + '\n'
-          # 'btime ' + btime + ' ' + \
-          # 'wtime ' + wtime + ' ' + \
-          # 'binc ' + binc + ' ' + \
-          # 'winc ' + winc + '\n'
-    else:
-      args = \
-         'position ' + position + '\n' + \
-         'moves ' + moves + '\n' + \
-         'go ' + \
-         'time ' + time + ' ' + \
-         'inc ' + inc + '\n'
-         # 'btime ' + btime + ' ' + \
-         # 'wtime ' + wtime + ' ' + \
-         # 'binc ' + binc + ' ' + \
-         # 'winc ' + winc + '\n'
- 
-    print args
-    player_in.write(args)
-
-    line = player_out.readline().strip()
-    while True:
-        if not line:
-            print "ERROR: Leiserchess Player Terminated"
-            break
-        print line
-
-        global info
-        info += line + '\n'
-
-        if line.startswith("bestmove "):
-            return line.split(" ")[1]
-        line = player_out.readline().strip()
+requests_lock = threading.Lock()
 
 # from http://stackoverflow.com/questions/3812849/how-to-check-whether-a-directory-is-a-sub-directory-of-another-directory
 def in_directory(file, directory):
@@ -96,6 +210,13 @@ class LeiserchessHandler(BaseHTTPRequestHandler):
         if self.path == "/":
             self.path = "/index.html"
 
+        if self.path.startswith("/stats/"):
+            self.send_response(200)
+            self.send_header('Content-type', "text/json")
+            self.end_headers()
+            self.wfile.write(json.dumps(pool.stats()))
+            return
+
         contentTypes = {
             ".html" : "text/html",
             ".js" : "application/javascript",
@@ -147,38 +268,54 @@ class LeiserchessHandler(BaseHTTPRequestHandler):
             gotime = postvars['gotime'][0]
             goinc = postvars['goinc'][0]
 
-            returnMove = play(position, moves, gotime, goinc);
+            req = pool.submit(position, moves, gotime, goinc)
 
-            pending_requests[next_req_id] = returnMove
+            with requests_lock:
+                reqid = next_req_id
+                pending_requests[reqid] = req
+                next_req_id = next_req_id + 1
 
             self.send_response(200)
             self.send_header('Content-type', "text/json")
             self.end_headers()
-            self.wfile.write('{"move":"' + returnMove + '", "reqid": "'+str(next_req_id)+'"}')
-            next_req_id = next_req_id + 1
+            self.wfile.write('{"move":"' + str(req.move) + '", "reqid": "'+str(reqid)+'"}')
 
             print time.time() - start_time
             return
 
         if self.path.startswith("/poll/"):
-            print "Polling for id " + str(postvars['reqid'][0])
-            returnMove = pending_requests[int(postvars['reqid'][0])]
-            print "return move is " + str(returnMove)
-            del pending_requests[int(postvars['reqid'][0])]
+            reqid = int(postvars['reqid'][0])
+            with requests_lock:
+                req = pending_requests.get(reqid)
+            if req is None:
+                self.send_error(404, 'Unknown request: %d' % reqid)
+                return
+
+            # the client polls again while the move is None
+            if req.done.wait(POLL_WAIT) and req.move is None:
+                self.send_error(500, 'Leiserchess Player Terminated')
+                return
+            if req.done.is_set():
+                with requests_lock:
+                    del pending_requests[reqid]
+
             self.send_response(200)
             self.send_header('Content-type', "text/json")
             self.end_headers()
 
-            global info
             output = {
-              "move": returnMove,
-              "info": info
+              "move": str(req.move),
+              "info": req.info
             }
             self.wfile.write(json.dumps(output))
             return
 
         self.send_error(404, 'File Not Found: %s' % self.path)
 
+# One thread per connection, so that polls wait without blocking other users
+class ThreadedHTTPServer(ThreadingMixIn, HTTPServer):
+    daemon_threads = True
+
 def main(argv = None):
     port = 5555
 
@@ -187,20 +324,17 @@ def main(argv = None):
     if len(argv) > 1:
         port = int(argv[1])
 
-    # Set up player
-    global player_in
-    global player_out
-    proc = subprocess.Popen(PLAYER, stdin=subprocess.PIPE, stdout=subprocess.PIPE, shell=True)
-    player_in = proc.stdin
-    player_out = proc.stdout
+    num_engines = NUM_ENGINES
+    if len(argv) > 2:
+        num_engines = int(argv[2])
 
-    player_in.write('uci\n')
-    while player_out.readline().strip() != "uciok":
-        pass
+    # Set up players
+    global pool
+    pool = EnginePool(num_engines)
 
     try:
-        server = HTTPServer(('', port), LeiserchessHandler)
-        print 'Start Leiserchess at port ' + str(port) + '...'
+        server = ThreadedHTTPServer(('', port), LeiserchessHandler)
+        print 'Start Leiserchess at port ' + str(port) + ' with ' + str(num_engines) + ' engines...'
         server.serve_forever()
     except KeyboardInterrupt:
         print '^C received, shutting down server'